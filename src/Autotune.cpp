@@ -0,0 +1,252 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <algorithm>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+
+#include "LockEngines.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Benchmarks every engine and wait-policy combination on a workload profile,
+// discards the weaker half after each round (successive halving, with longer
+// trials each round), and writes the winner to a recommendation file that
+// makeRecommendedEngine() reads at runtime.
+//
+// Usage: Autotune [-t threads] [-c cs_ns] [-f footprint_bytes] [-r read_ratio]
+//                 [-d first_trial_ms] [-o recommendation_file]
+// Without arguments it tunes a small default profile and checks the result.
+
+struct Profile {
+    int threads = 4;
+    int csNs = 200;          // Extra time spent inside each critical section
+    size_t footprint = 1024; // Shared data touched per critical section, in bytes
+    double readRatio = 0.5;  // Fraction of operations that only read
+};
+
+struct Candidate {
+    string engine;
+    string spin;
+    double throughput = 0;
+};
+
+const int CACHE_LINE_WORDS = 64 / sizeof(uint64_t);
+const double DROP_BELOW_BEST = 0.5; // Stop early on anything this far behind
+
+void spinFor(uint64_t ns) {
+    uint64_t until = lockstats::nowNs() + ns;
+    while (lockstats::nowNs() < until) {
+    }
+}
+
+struct SharedData {
+    vector<uint64_t> words;
+    long writes = 0;
+
+    SharedData(size_t bytes) : words(max<size_t>(bytes / sizeof(uint64_t), 1)) {}
+
+    void write() {
+        for (size_t i = 0; i < words.size(); i += CACHE_LINE_WORDS) words[i]++;
+        writes++;
+    }
+
+    uint64_t read() const {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < words.size(); i += CACHE_LINE_WORDS) sum += words[i];
+        return sum;
+    }
+};
+
+// Trials in which an engine broke mutual exclusion
+int lostUpdateTrials = 0;
+
+// Closed-loop trial; returns operations per second, or 0 (and counts the
+// trial in lostUpdateTrials) if updates were lost
+double runTrial(LockEngine& engine, const Profile& p, int trialMs) {
+    SharedData data(p.footprint);
+    atomic<bool> stop(false);
+    vector<long> ops(p.threads, 0);
+
+    auto worker = [&](int id) {
+        mt19937 rng(id + 1);
+        bernoulli_distribution isRead(p.readRatio);
+        volatile uint64_t sink = 0;
+        while (!stop.load(memory_order_relaxed)) {
+            if (isRead(rng)) {
+                engine.executeShared(id, [&] {
+                    sink = sink + data.read();
+                    spinFor(p.csNs);
+                });
+            } else {
+                engine.execute(id, [&] {
+                    data.write();
+                    spinFor(p.csNs);
+                });
+            }
+            ops[id]++;
+        }
+    };
+
+    auto start = high_resolution_clock::now();
+    vector<thread> threads;
+    for (int i = 0; i < p.threads; ++i) {
+        threads.emplace_back(worker, i);
+    }
+    this_thread::sleep_for(milliseconds(trialMs));
+    stop = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    double seconds = duration<double>(high_resolution_clock::now() - start).count();
+
+    if ((long)data.words[0] != data.writes) {
+        cout << "Error: " << engine.name() << " lost updates (" << data.words[0]
+             << " of " << data.writes << ")" << endl;
+        lostUpdateTrials++;
+        return 0;
+    }
+    long total = 0;
+    for (long n : ops) total += n;
+    return total / seconds;
+}
+
+vector<Candidate> allCandidates() {
+    vector<Candidate> list;
+    for (const char* engine : {"mutex", "rwlock"}) {
+        list.push_back({engine, "calibrated"});
+    }
+    for (const char* engine : {"bakery", "delegation"}) {
+        for (const char* spin : SPIN_POLICIES) {
+            list.push_back({engine, spin});
+        }
+    }
+    return list;
+}
+
+Candidate tune(const Profile& p, int firstTrialMs) {
+    vector<Candidate> alive = allCandidates();
+    int trialMs = firstTrialMs;
+
+    for (int round = 1; alive.size() > 1; ++round, trialMs *= 2) {
+        cout << "Round " << round << " (" << trialMs << " ms trials):" << endl;
+        for (Candidate& c : alive) {
+            auto engine = makeEngine(c.engine, p.threads, c.spin);
+            c.throughput = runTrial(*engine, p, trialMs);
+            cout << "  " << setw(12) << left << c.engine << setw(12) << c.spin << right
+                 << fixed << setprecision(0) << c.throughput << " ops/sec" << endl;
+        }
+        sort(alive.begin(), alive.end(), [](const Candidate& a, const Candidate& b) {
+            return a.throughput > b.throughput;
+        });
+
+        // Keep the better half, and nothing that is far behind the leader
+        size_t keep = (alive.size() + 1) / 2;
+        while (keep > 1 && alive[keep - 1].throughput < DROP_BELOW_BEST * alive[0].throughput) {
+            keep--;
+        }
+        alive.resize(keep);
+    }
+    return alive[0];
+}
+
+bool writeRecommendation(const string& path, const Profile& p, const Candidate& c) {
+    ofstream out(path);
+    out << "# Lock recommendation written by Autotune\n"
+        << "threads=" << p.threads << "\n"
+        << "cs_ns=" << p.csNs << "\n"
+        << "footprint=" << p.footprint << "\n"
+        << "read_ratio=" << p.readRatio << "\n"
+        << "engine=" << c.engine << "\n"
+        << "spin=" << c.spin << "\n"
+        << "throughput=" << (long)c.throughput << "\n";
+    return (bool)out;
+}
+
+// Drives increments through the factory-built engine and checks none are lost
+bool testRecommendedEngine(const string& path, int threadCount) {
+    const int operations = 2000;
+    auto engine = makeRecommendedEngine(path, threadCount);
+    long counter = 0;
+
+    vector<thread> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back([&, i] {
+            for (int j = 0; j < operations; ++j) {
+                engine->execute(i, [&counter] { counter++; });
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    long expected = (long)threadCount * operations;
+    if (counter != expected) {
+        cout << "Error: Expected " << expected << ", got " << counter << endl;
+        return false;
+    }
+    cout << "Correctness test passed with recommended engine " << engine->name() << endl;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Profile p;
+    int firstTrialMs = 20;
+    string output;
+    bool selfTest = argc == 1;
+
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 >= argc) {
+            cerr << "Usage: " << argv[0] << " [-t threads] [-c cs_ns] [-f footprint_bytes]"
+                 << " [-r read_ratio] [-d first_trial_ms] [-o file]" << endl;
+            return 1;
+        }
+        if (!strcmp(argv[i], "-t")) p.threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-c")) p.csNs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-f")) p.footprint = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "-r")) p.readRatio = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-d")) firstTrialMs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o")) output = argv[++i];
+        else {
+            cerr << "Error: unknown option " << argv[i] << endl;
+            return 1;
+        }
+    }
+    if (selfTest) {
+        firstTrialMs = 10;
+        output = "/tmp/autotune_" + to_string(getpid()) + ".txt";
+    } else if (output.empty()) {
+        output = "lock_recommendation.txt";
+    }
+
+    cout << "Profile: " << p.threads << " threads, " << p.csNs << " ns critical sections, "
+         << p.footprint << " bytes shared, read ratio " << p.readRatio << endl;
+    Candidate best = tune(p, firstTrialMs);
+    cout << "Recommendation: " << best.engine << " (" << best.spin << ")" << endl;
+
+    if (lostUpdateTrials > 0) {
+        cout << "Error: " << lostUpdateTrials << " trials lost updates" << endl;
+        return 1;
+    }
+
+    if (!writeRecommendation(output, p, best)) {
+        cerr << "Error: cannot write " << output << endl;
+        return 1;
+    }
+    if (!selfTest) {
+        cout << "Wrote " << output << endl;
+        return 0;
+    }
+
+    bool ok = testRecommendedEngine(output, p.threads);
+    remove(output.c_str());
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "Calibration.h"
+#include "LockStats.h"
+
+class BakeryLock {
+private:
+    std::vector<std::atomic<bool>> choosing;
+    std::vector<std::atomic<int>> ticket;
+    int threadCount;
+    lockstats::StatsWriter stats;
+    Calibration calib;
+
+public:
+    BakeryLock(int n, const Calibration& c = hostCalibration())
+        : choosing(n), ticket(n), threadCount(n), stats("bakery", "BakeryLock"), calib(c) {
+        for (int i = 0; i < n; ++i) {
+            choosing[i] = false;
+            ticket[i] = 0;
+        }
+    }
+
+    void lock(int id) {
+        uint64_t start = lockstats::nowNs();
+        bool contended = false;
+        choosing[id] = true;
+
+        // Find max ticket and add 1
+        int max_ticket = 0;
+        for (int i = 0; i < threadCount; ++i) {
+            int current = ticket[i];
+            max_ticket = std::max(max_ticket, current);
+        }
+        ticket[id] = max_ticket + 1;
+        choosing[id] = false;
+
+        // Wait until it's our turn
+        for (int i = 0; i < threadCount; ++i) {
+            if (i == id) continue;
+
+            // Wait until thread i finishes choosing
+            SpinWait choosingWait(calib.spinBeforeYield, calib);
+            while (choosing[i]) {
+                contended = true;
+                choosingWait.once();
+            }
+
+            // Wait until our ticket is the smallest
+            SpinWait ticketWait(calib.spinBeforeYield, calib);
+            while (ticket[i] != 0 &&
+                  (ticket[i] < ticket[id] ||
+                  (ticket[i] == ticket[id] && i < id))) {
+                contended = true;
+                ticketWait.once();
+            }
+        }
+
+        // We hold the lock, so we are the only writer of the stats slot
+        stats.recordAcquire(contended, lockstats::nowNs() - start);
+    }
+
+    void unlock(int id) {
+        ticket[id] = 0;
+    }
+};
@@ -0,0 +1,52 @@
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+
+#include "Calibration.h"
+
+using namespace std;
+
+// Measures this host's spin/yield/park costs, prints the derived thresholds
+// and refreshes the cache file the engines read at startup.
+//
+// Usage: Calibrate [--cached]   (--cached prints the cached values only)
+
+void printCalibration(const Calibration& c) {
+    cout << fixed << setprecision(1)
+         << "CPUs available:     " << c.cpus << " (" << c.cpuList << ")\n"
+         << "Pause latency:      " << c.pauseNs << " ns\n"
+         << "Yield cost:         " << c.yieldNs << " ns\n"
+         << "Futex wake latency: " << c.futexWakeNs << " ns\n"
+         << "Cross-core handoff: " << c.handoffNs << " ns\n"
+         << "Spin before yield:  " << c.spinBeforeYield << " pauses\n"
+         << "Spin before park:   " << c.spinBeforePark << " pauses\n"
+         << "Backoff cap:        " << c.backoffCap << " pauses" << endl;
+}
+
+int main(int argc, char** argv) {
+    string path = calibration::cachePath();
+
+    if (argc == 2 && !strcmp(argv[1], "--cached")) {
+        Calibration c;
+        if (!c.load(path)) {
+            cerr << "Error: no calibration cached in " << path << " for CPUs "
+                 << cpuListString(availableCpus()) << endl;
+            return 1;
+        }
+        printCalibration(c);
+        return 0;
+    }
+    if (argc != 1) {
+        cerr << "Usage: " << argv[0] << " [--cached]" << endl;
+        return 1;
+    }
+
+    Calibration c = calibration::measure();
+    printCalibration(c);
+    if (!c.save(path)) {
+        cerr << "Error: cannot write " << path << endl;
+        return 1;
+    }
+    cout << "Cached in " << path << endl;
+    return 0;
+}
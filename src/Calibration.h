@@ -0,0 +1,276 @@
+#pragma once
+
+// Per-host calibration of the spin/yield/park trade-off.
+//
+// The first engine that needs it measures pause latency, yield cost, futex
+// wake latency and cross-core handoff cost, derives spin thresholds from
+// them and caches the result in a file, so later runs on the same host skip
+// the measurement. Engines wait through SpinWait, which applies them.
+//
+// The cache records the CPU set it was measured on, and a process allowed a
+// different set (under taskset or a cgroup, say) measures again.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "LockStats.h"
+#include "Placement.h"
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+struct Calibration {
+    // Measured costs, in nanoseconds
+    double pauseNs = 0;
+    double yieldNs = 0;
+    double futexWakeNs = 0;
+    double handoffNs = 0;
+    int cpus = 1;
+    std::string cpuList; // CPUs measured on, in cpulist format
+
+    // Derived thresholds, in pause instructions
+    int spinBeforeYield = 0; // Bakery-style waits yield after this much spinning
+    int spinBeforePark = 0;  // Blocking waits park after this much spinning
+    int backoffCap = 1;      // Longest single backoff step
+
+    void derive() {
+        if (cpus <= 1 || pauseNs <= 0) {
+            // Whoever we wait for cannot run while we spin
+            spinBeforeYield = 0;
+            spinBeforePark = 0;
+            backoffCap = 1;
+            return;
+        }
+        // Spin long enough to catch a handoff in flight, and no longer than
+        // blocking would have cost (the classic competitive spinning bound)
+        spinBeforeYield = std::clamp((int)(2 * handoffNs / pauseNs), 16, 1 << 16);
+        spinBeforePark = std::clamp((int)(futexWakeNs / pauseNs), 16, 1 << 18);
+        backoffCap = std::clamp((int)(handoffNs / pauseNs), 1, 1024);
+    }
+
+    // Writes a fresh file beside path and renames it into place, so a
+    // symlink planted at path (the default lives in /tmp) is replaced, not
+    // followed, and a reader never sees half a file.
+    bool save(const std::string& path) const {
+        std::ostringstream out;
+        out << "version=2\n"
+            << "pause_ns=" << pauseNs << "\n"
+            << "yield_ns=" << yieldNs << "\n"
+            << "futex_wake_ns=" << futexWakeNs << "\n"
+            << "handoff_ns=" << handoffNs << "\n"
+            << "cpus=" << cpus << "\n"
+            << "cpu_list=" << cpuList << "\n";
+        std::string text = out.str();
+
+        std::string temp = path + ".XXXXXX";
+        int fd = mkstemp(&temp[0]);
+        if (fd < 0) return false;
+        bool ok = write(fd, text.data(), text.size()) == (ssize_t)text.size();
+        ok = close(fd) == 0 && ok;
+        ok = ok && std::rename(temp.c_str(), path.c_str()) == 0;
+        if (!ok) unlink(temp.c_str());
+        return ok;
+    }
+
+    // Thresholds are re-derived on load, so the file only holds measurements.
+    // False if the file is missing or incomplete, or was measured on a CPU
+    // set other than this process's.
+    bool load(const std::string& path) {
+        std::ifstream in(path);
+        std::string line;
+        bool versionOk = false;
+        int fields = 0;
+        while (std::getline(in, line)) {
+            size_t eq = line.find('=');
+            if (eq == std::string::npos) continue;
+            std::string key = line.substr(0, eq);
+            double value = std::atof(line.c_str() + eq + 1);
+            if (key == "version") versionOk = value == 2;
+            else if (key == "pause_ns") { pauseNs = value; fields++; }
+            else if (key == "yield_ns") { yieldNs = value; fields++; }
+            else if (key == "futex_wake_ns") { futexWakeNs = value; fields++; }
+            else if (key == "handoff_ns") { handoffNs = value; fields++; }
+            else if (key == "cpus") { cpus = (int)value; fields++; }
+            else if (key == "cpu_list") { cpuList = line.substr(eq + 1); fields++; }
+        }
+        if (!versionOk || fields != 6 || cpuList != cpuListString(availableCpus())) return false;
+        derive();
+        return true;
+    }
+};
+
+namespace calibration {
+
+const int PAUSE_ROUNDS = 100000;
+const int YIELD_ROUNDS = 10000;
+const int FUTEX_ROUNDS = 200;
+const int HANDOFF_ROUNDS = 2000;
+
+inline long futex(std::atomic<int>* addr, int op, int value) {
+    return syscall(SYS_futex, reinterpret_cast<int*>(addr), op, value, nullptr, nullptr, 0);
+}
+
+inline double measurePause() {
+    uint64_t start = lockstats::nowNs();
+    for (int i = 0; i < PAUSE_ROUNDS; ++i) cpuRelax();
+    return double(lockstats::nowNs() - start) / PAUSE_ROUNDS;
+}
+
+inline double measureYield() {
+    uint64_t start = lockstats::nowNs();
+    for (int i = 0; i < YIELD_ROUNDS; ++i) std::this_thread::yield();
+    return double(lockstats::nowNs() - start) / YIELD_ROUNDS;
+}
+
+// Time from FUTEX_WAKE to the sleeper running again
+inline double measureFutexWake(const std::vector<int>& cpus) {
+    std::atomic<int> word(0);
+    std::atomic<uint64_t> wokenAt(0);
+    std::atomic<int> round(0);
+    uint64_t total = 0;
+
+    std::thread sleeper([&] {
+        pinCurrentThread(cpus.back());
+        for (int r = 1; r <= FUTEX_ROUNDS; ++r) {
+            while (word.load() != r) {
+                futex(&word, FUTEX_WAIT_PRIVATE, r - 1);
+            }
+            wokenAt.store(lockstats::nowNs());
+            round.store(r);
+        }
+    });
+    pinCurrentThread(cpus.front());
+    for (int r = 1; r <= FUTEX_ROUNDS; ++r) {
+        // Give the sleeper time to block, so we measure a real wakeup
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        uint64_t wakeAt = lockstats::nowNs();
+        word.store(r);
+        futex(&word, FUTEX_WAKE_PRIVATE, 1);
+        while (round.load() != r) std::this_thread::yield();
+        total += wokenAt.load() - wakeAt;
+    }
+    sleeper.join();
+    return double(total) / FUTEX_ROUNDS;
+}
+
+// One-way cache-line handoff between the first two CPUs
+inline double measureHandoff(const std::vector<int>& cpus) {
+    struct alignas(64) { std::atomic<int> value{0}; } flag;
+    bool shared = cpus.size() < 2;
+    auto waitFor = [&](int v) {
+        while (flag.value.load(std::memory_order_acquire) != v) {
+            if (shared) std::this_thread::yield();
+        }
+    };
+
+    std::thread other([&] {
+        pinCurrentThread(cpus.back());
+        for (int i = 0; i < HANDOFF_ROUNDS; ++i) {
+            waitFor(1);
+            flag.value.store(0, std::memory_order_release);
+        }
+    });
+    pinCurrentThread(cpus.front());
+    uint64_t start = lockstats::nowNs();
+    for (int i = 0; i < HANDOFF_ROUNDS; ++i) {
+        flag.value.store(1, std::memory_order_release);
+        waitFor(0);
+    }
+    uint64_t elapsed = lockstats::nowNs() - start;
+    other.join();
+    return double(elapsed) / HANDOFF_ROUNDS / 2;
+}
+
+// Measures in a helper thread so the caller's CPU affinity is untouched.
+inline Calibration measure() {
+    Calibration c;
+    std::thread([&c] {
+        std::vector<int> cpus = availableCpus();
+        c.cpus = (int)cpus.size();
+        c.cpuList = cpuListString(cpus);
+        c.pauseNs = measurePause();
+        c.yieldNs = measureYield();
+        c.futexWakeNs = measureFutexWake(cpus);
+        c.handoffNs = measureHandoff(cpus);
+    }).join();
+    c.derive();
+    return c;
+}
+
+inline std::string cachePath() {
+    const char* env = std::getenv("LOCK_CALIBRATION_FILE");
+    if (env && *env) return env;
+    char host[64] = "host";
+    gethostname(host, sizeof(host) - 1);
+    return std::string("/tmp/lock_calibration_") + host + ".txt";
+}
+
+} // namespace calibration
+
+// The calibration for this host: loaded from the cache file if present,
+// measured (and cached) otherwise. Done once per process.
+inline const Calibration& hostCalibration() {
+    static const Calibration instance = [] {
+        Calibration c;
+        std::string path = calibration::cachePath();
+        if (!c.load(path)) {
+            c = calibration::measure();
+            c.save(path);
+        }
+        return c;
+    }();
+    return instance;
+}
+
+// Same measurements with spinning disabled: waits yield or park at once.
+inline Calibration noSpinCalibration(const Calibration& c = hostCalibration()) {
+    Calibration n = c;
+    n.spinBeforeYield = 0;
+    n.spinBeforePark = 0;
+    n.backoffCap = 1;
+    return n;
+}
+
+// Waiting strategy shared by the engines: exponential backoff of pause
+// instructions up to a calibrated budget, then either yield (once()) or tell
+// the caller to park (spin() returns false).
+class SpinWait {
+private:
+    int budget;
+    int cap;
+    int spun = 0;
+    int step = 1;
+
+public:
+    explicit SpinWait(int spinBudget, const Calibration& c = hostCalibration())
+        : budget(spinBudget), cap(c.backoffCap) {}
+
+    bool spin() {
+        if (spun >= budget) return false;
+        for (int i = 0; i < step; ++i) cpuRelax();
+        spun += step;
+        step = std::min(step * 2, cap);
+        return true;
+    }
+
+    void once() {
+        if (!spin()) std::this_thread::yield();
+    }
+};
@@ -0,0 +1,212 @@
+#pragma once
+
+// Typed-operation delegation: the server drains every pending request as one
+// batch, merges commutative operations (a run of adds becomes one add) and
+// cancels inverse pairs (a pop takes the value of a push in the same batch)
+// before touching the shared object. Results are exactly those of running
+// the batch in submission order. Operations that declare they commute may in
+// addition be moved behind the others and grouped by type, which lets more of
+// them merge or cancel.
+//
+// An object type has `void apply(std::vector<combining::Request*>& batch,
+// combining::CombineStats& stats)`, which runs the batch in order and fills
+// in each request's result.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Calibration.h"
+
+namespace combining {
+
+enum OpType { ADD, GET, PUSH, POP, ENQUEUE, DEQUEUE };
+
+struct Request {
+    OpType type;
+    long value;
+    bool commutes;
+    long result = 0;
+    bool ok = false; // False for a pop/dequeue that found nothing
+    std::atomic<bool> done{false};
+};
+
+struct CombineStats {
+    long batches = 0;
+    long ops = 0;
+    long merged = 0;     // Operations folded into another one
+    long eliminated = 0; // Operations cancelled against their inverse (counted per pair)
+};
+
+struct CounterObject {
+    long value = 0;
+
+    void apply(std::vector<Request*>& batch, CombineStats& stats) {
+        long runSum = 0;
+        long runLength = 0;
+        auto closeRun = [&] {
+            value += runSum;
+            stats.merged += std::max(runLength - 1, 0L);
+            runSum = 0;
+            runLength = 0;
+        };
+        for (Request* r : batch) {
+            if (r->type == ADD) {
+                r->result = value + runSum; // Fetch-and-add: value before this add
+                r->ok = true;
+                runSum += r->value;
+                runLength++;
+            } else {
+                closeRun();
+                r->result = value;
+                r->ok = true;
+            }
+        }
+        closeRun();
+    }
+};
+
+struct StackObject {
+    std::vector<long> items;
+
+    void apply(std::vector<Request*>& batch, CombineStats& stats) {
+        // Pushes from this batch sit on top of the stack, so a pop takes the
+        // most recent one still unmatched; only unmatched ones reach `items`
+        std::vector<Request*> pushes;
+        for (Request* r : batch) {
+            if (r->type == PUSH) {
+                r->ok = true;
+                pushes.push_back(r);
+            } else if (!pushes.empty()) {
+                r->result = pushes.back()->value;
+                r->ok = true;
+                pushes.pop_back();
+                stats.eliminated++;
+            } else if (!items.empty()) {
+                r->result = items.back();
+                r->ok = true;
+                items.pop_back();
+            } else {
+                r->ok = false;
+            }
+        }
+        for (Request* p : pushes) {
+            items.push_back(p->value);
+        }
+    }
+};
+
+struct QueueObject {
+    std::deque<long> items;
+
+    void apply(std::vector<Request*>& batch, CombineStats& stats) {
+        // An enqueue from this batch can only be dequeued once the shared
+        // queue has drained; in that case the pair never touches `items`
+        std::vector<Request*> enqueues;
+        size_t head = 0;
+        for (Request* r : batch) {
+            if (r->type == ENQUEUE) {
+                r->ok = true;
+                enqueues.push_back(r);
+            } else if (!items.empty()) {
+                r->result = items.front();
+                r->ok = true;
+                items.pop_front();
+            } else if (head < enqueues.size()) {
+                r->result = enqueues[head++]->value;
+                r->ok = true;
+                stats.eliminated++;
+            } else {
+                r->ok = false;
+            }
+        }
+        for (size_t i = head; i < enqueues.size(); ++i) {
+            items.push_back(enqueues[i]->value);
+        }
+    }
+};
+
+} // namespace combining
+
+template <typename Object>
+class CombiningDelegationLock {
+private:
+    Object object;
+    combining::CombineStats stats;
+    std::vector<combining::Request*> pending;
+    std::mutex queueMutex;
+    std::condition_variable queueCV;
+    bool running = true;
+    std::thread serverThread;
+    Calibration calib;
+
+    void server() {
+        std::vector<combining::Request*> batch;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueCV.wait(lock, [this] { return !pending.empty() || !running; });
+                if (pending.empty()) return;
+                batch.swap(pending);
+            }
+
+            // Commuting operations go last, grouped by type (adds before
+            // reads, pushes before pops, enqueues before dequeues)
+            auto tail = std::stable_partition(batch.begin(), batch.end(),
+                                         [](const combining::Request* r) { return !r->commutes; });
+            std::stable_sort(tail, batch.end(),
+                        [](const combining::Request* a, const combining::Request* b) { return a->type < b->type; });
+
+            object.apply(batch, stats);
+            stats.batches++;
+            stats.ops += batch.size();
+
+            for (combining::Request* r : batch) {
+                r->done.store(true, std::memory_order_release);
+            }
+            batch.clear();
+        }
+    }
+
+public:
+    CombiningDelegationLock() : calib(hostCalibration()) {
+        serverThread = std::thread(&CombiningDelegationLock::server, this);
+    }
+
+    ~CombiningDelegationLock() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            running = false;
+        }
+        queueCV.notify_one();
+        serverThread.join();
+    }
+
+    // Blocks until the server has run the operation; returns its result.
+    long submit(combining::OpType type, long value = 0, bool commutes = false, bool* ok = nullptr) {
+        combining::Request r;
+        r.type = type;
+        r.value = value;
+        r.commutes = commutes;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            pending.push_back(&r);
+        }
+        queueCV.notify_one();
+
+        SpinWait wait(calib.spinBeforeYield, calib);
+        while (!r.done.load(std::memory_order_acquire)) {
+            wait.once();
+        }
+        if (ok) *ok = r.ok;
+        return r.result;
+    }
+
+    // Only meaningful once all clients have finished
+    const Object& state() const { return object; }
+    const combining::CombineStats& combineStats() const { return stats; }
+};
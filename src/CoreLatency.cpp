@@ -0,0 +1,196 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+
+#include "BakeryLock.h"
+#include "DelegationLock.h"
+#include "Placement.h"
+
+using namespace std;
+
+// Measures, for every pair of CPUs, the round-trip latency of an atomic
+// cache-line ping-pong and of a lock handoff through each engine, prints the
+// matrices and writes them as CSV for the placement planner (Placement.h).
+//
+// Usage: CoreLatency [-r rounds] [-o file.csv]
+
+const int DEFAULT_ROUNDS = 2000;
+const int SPINS_BEFORE_YIELD = 256;
+
+struct alignas(64) PaddedFlag {
+    atomic<int> value{0};
+};
+
+// Spins briefly, then yields, so pairs that share a CPU still make progress
+template <typename Pred>
+void waitUntil(Pred pred) {
+    for (int spins = 0; !pred(); ++spins) {
+        if (spins >= SPINS_BEFORE_YIELD) {
+            this_thread::yield();
+        }
+    }
+}
+
+// Runs `ping` on cpu a and `pong` on cpu b, returns ns per round trip
+template <typename Ping, typename Pong>
+double timePair(int a, int b, int rounds, Ping ping, Pong pong) {
+    atomic<int> ready(0);
+    thread other([&] {
+        pinCurrentThread(b);
+        ready++;
+        waitUntil([&] { return ready.load() == 2; });
+        for (int i = 0; i < rounds; ++i) pong();
+    });
+    pinCurrentThread(a);
+    ready++;
+    waitUntil([&] { return ready.load() == 2; });
+    uint64_t start = lockstats::nowNs();
+    for (int i = 0; i < rounds; ++i) ping();
+    uint64_t end = lockstats::nowNs();
+    other.join();
+    return double(end - start) / rounds;
+}
+
+double pingPong(int a, int b, int rounds) {
+    PaddedFlag flag;
+    return timePair(a, b, rounds,
+        [&] {
+            flag.value.store(1, memory_order_release);
+            waitUntil([&] { return flag.value.load(memory_order_acquire) == 0; });
+        },
+        [&] {
+            waitUntil([&] { return flag.value.load(memory_order_acquire) == 1; });
+            flag.value.store(0, memory_order_release);
+        });
+}
+
+// Two threads take turns owning the lock; one round trip is two handoffs
+template <typename Lock, typename Unlock>
+double lockHandoff(int a, int b, int rounds, Lock lock, Unlock unlock) {
+    PaddedFlag turn;
+    return timePair(a, b, rounds,
+        [&] {
+            waitUntil([&] { return turn.value.load(memory_order_acquire) == 0; });
+            lock(0);
+            turn.value.store(1, memory_order_release);
+            unlock(0);
+        },
+        [&] {
+            waitUntil([&] { return turn.value.load(memory_order_acquire) == 1; });
+            lock(1);
+            turn.value.store(0, memory_order_release);
+            unlock(1);
+        });
+}
+
+double mutexHandoff(int a, int b, int rounds) {
+    mutex m;
+    return lockHandoff(a, b, rounds, [&](int) { m.lock(); }, [&](int) { m.unlock(); });
+}
+
+double bakeryHandoff(int a, int b, int rounds) {
+    BakeryLock lock(2);
+    return lockHandoff(a, b, rounds, [&](int id) { lock.lock(id); }, [&](int id) { lock.unlock(id); });
+}
+
+// Client on a, server pinned on b; one round trip is one empty request
+double delegationRoundTrip(int a, int b, int rounds) {
+    DelegationLock lock(b);
+    pinCurrentThread(a);
+    lock.async([] {}).wait(); // Let the server pin itself and warm up
+    uint64_t start = lockstats::nowNs();
+    for (int i = 0; i < rounds; ++i) {
+        lock.async([] {}).wait();
+    }
+    return double(lockstats::nowNs() - start) / rounds;
+}
+
+struct Metric {
+    const char* name;
+    double (*measure)(int, int, int);
+};
+
+const Metric METRICS[] = {
+    {"pingpong", pingPong},
+    {"mutex", mutexHandoff},
+    {"bakery", bakeryHandoff},
+    {"delegation", delegationRoundTrip},
+};
+
+void printMatrix(const char* name, const LatencyMatrix& m) {
+    cout << "\n" << name << " round trip (ns), row = from CPU, column = to CPU\n";
+    cout << setw(6) << "";
+    for (int cpu : m.cpus) cout << setw(9) << cpu;
+    cout << "\n";
+    for (int i = 0; i < m.size(); ++i) {
+        cout << setw(6) << m.cpus[i];
+        for (int j = 0; j < m.size(); ++j) {
+            if (i == j && m.size() > 1) {
+                cout << setw(9) << "-";
+            } else {
+                cout << setw(9) << fixed << setprecision(0) << m.at(i, j);
+            }
+        }
+        cout << "\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    int rounds = DEFAULT_ROUNDS;
+    const char* output = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            cerr << "Usage: " << argv[0] << " [-r rounds] [-o file.csv]" << endl;
+            return 1;
+        }
+    }
+
+    vector<int> cpus = availableCpus();
+    cout << "Measuring " << cpus.size() << " CPUs, " << rounds << " round trips per pair" << endl;
+    if (cpus.size() == 1) {
+        cout << "Only one CPU available: measuring the same-CPU case only" << endl;
+    }
+
+    ofstream csv;
+    if (output) {
+        csv.open(output);
+        if (!csv) {
+            cerr << "Error: cannot write " << output << endl;
+            return 1;
+        }
+        csv << "# metric,from_cpu,to_cpu,ns\n";
+    }
+
+    for (const Metric& metric : METRICS) {
+        LatencyMatrix m;
+        m.resize(cpus);
+        for (int i = 0; i < m.size(); ++i) {
+            for (int j = 0; j < m.size(); ++j) {
+                // The diagonal is only meaningful when there is nothing else
+                if (i == j && m.size() > 1) continue;
+                m.at(i, j) = metric.measure(cpus[i], cpus[j], rounds);
+                if (csv.is_open()) {
+                    csv << metric.name << "," << cpus[i] << "," << cpus[j] << ","
+                        << fixed << setprecision(1) << m.at(i, j) << "\n";
+                }
+            }
+        }
+        printMatrix(metric.name, m);
+    }
+
+    if (output) {
+        cout << "\nWrote " << output << endl;
+    }
+    return 0;
+}
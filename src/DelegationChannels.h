@@ -0,0 +1,165 @@
+#pragma once
+
+// Delegation over per-client channels.
+//
+// Each client connects once and gets its own Channel, a single-producer
+// single-consumer ring only that client pushes to. The server sweeps the
+// channels round-robin and runs at most `quota` requests from each per
+// sweep, so clients never write a shared cache line to submit, and one busy
+// client cannot take more than its quota of the server while others wait.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Calibration.h"
+#include "LockStats.h"
+#include "SpscRing.h"
+
+class DelegationChannels {
+public:
+    class Channel {
+    private:
+        friend class DelegationChannels;
+
+        struct Request {
+            std::function<void()> work;
+            std::promise<void> completion;
+        };
+
+        DelegationChannels& server;
+        SpscRing<Request> ring;
+
+        Channel(DelegationChannels& s, size_t capacity) : server(s), ring(capacity) {}
+
+    public:
+        // Only the thread that owns the channel may call this. Waits for a
+        // slot if the ring is full.
+        std::future<void> async(std::function<void()> work) {
+            Request request;
+            request.work = std::move(work);
+            auto fut = request.completion.get_future();
+            SpinWait full(server.calib.spinBeforeYield, server.calib);
+            while (!ring.tryPush(request)) {
+                full.once();
+            }
+            server.wake();
+            return fut;
+        }
+
+        size_t pending() const { return ring.size(); }
+    };
+
+    static const int MAX_CHANNELS = 256;
+
+private:
+    std::unique_ptr<Channel> channels[MAX_CHANNELS];
+    std::atomic<int> channelCount{0};
+    std::mutex connectMutex;
+    size_t ringCapacity;
+    size_t quota;
+
+    std::atomic<bool> running{true};
+    std::atomic<bool> sleeping{false};
+    std::mutex sleepMutex;
+    std::condition_variable sleepCV;
+    lockstats::StatsWriter stats;
+    Calibration calib;
+    std::thread serverThread;
+
+    bool anyPending() const {
+        int n = channelCount.load(std::memory_order_acquire);
+        for (int i = 0; i < n; ++i) {
+            if (!channels[i]->ring.empty()) return true;
+        }
+        return false;
+    }
+
+    void wake() {
+        // Pairs with the fence in serve(): either we see it sleeping, or it
+        // sees our request before it blocks
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            sleepCV.notify_one();
+        }
+    }
+
+    void serve() {
+        Channel::Request request;
+        uint64_t startedNs = lockstats::nowNs();
+        for (;;) {
+            SpinWait idle(calib.spinBeforePark, calib);
+            while (!anyPending() && idle.spin()) {
+            }
+            if (!anyPending()) {
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                sleeping.store(true, std::memory_order_seq_cst);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                sleepCV.wait(lock, [this] { return anyPending() || !running; });
+                sleeping.store(false, std::memory_order_relaxed);
+            }
+            if (!anyPending()) return; // Stopped and drained
+
+            // One sweep: up to quota requests from each channel in turn
+            uint64_t begin = lockstats::nowNs();
+            size_t ran = 0;
+            int busyChannels = 0;
+            int n = channelCount.load(std::memory_order_acquire);
+            for (int i = 0; i < n; ++i) {
+                SpscRing<Channel::Request>& ring = channels[i]->ring;
+                size_t taken = 0;
+                while (taken < quota && ring.tryPop(request)) {
+                    request.work();
+                    request.completion.set_value();
+                    taken++;
+                }
+                ran += taken;
+                busyChannels += taken > 0;
+            }
+            uint64_t end = lockstats::nowNs();
+            stats.recordTask(busyChannels > 1, 0, ran, end - begin, end - startedNs);
+        }
+    }
+
+public:
+    // ringCapacity: requests each channel can hold; quota: requests the
+    // server takes from one channel per sweep.
+    explicit DelegationChannels(size_t ringCapacity = 64, size_t quota = 8,
+                                const Calibration& c = hostCalibration())
+        : ringCapacity(ringCapacity), quota(std::max<size_t>(quota, 1)),
+          stats("delegation", "DelegationChannels"), calib(c) {
+        serverThread = std::thread(&DelegationChannels::serve, this);
+    }
+
+    ~DelegationChannels() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            running = false;
+        }
+        sleepCV.notify_one();
+        serverThread.join();
+    }
+
+    DelegationChannels(const DelegationChannels&) = delete;
+    DelegationChannels& operator=(const DelegationChannels&) = delete;
+
+    // A new channel for one client thread; it lives as long as the server.
+    // Returns nullptr once MAX_CHANNELS are connected.
+    Channel* connect() {
+        std::lock_guard<std::mutex> lock(connectMutex);
+        int n = channelCount.load(std::memory_order_relaxed);
+        if (n == MAX_CHANNELS) return nullptr;
+        channels[n].reset(new Channel(*this, ringCapacity));
+        channelCount.store(n + 1, std::memory_order_release);
+        return channels[n].get();
+    }
+
+    int channelsConnected() const { return channelCount.load(); }
+};
@@ -0,0 +1,300 @@
+#pragma once
+
+// A delegation server that is also an event loop.
+//
+// The server sleeps in epoll_wait rather than on a condition variable, so
+// besides running requests it can watch file descriptors and timers. Their
+// handlers run on the server thread like requests, so they have the same
+// exclusive access to the delegated state: one thread owns a shard and
+// serves its sockets, timers and in-process clients.
+//
+// Clients wake the server through an eventfd. Wakeups are coalesced: only a
+// client that finds the server asleep signals, and only the first of those
+// until the server has taken the signal, so a busy or already-woken server
+// costs a client no system call.
+//
+// Between batches of requests the server polls its descriptors without
+// blocking, so a steady stream of requests cannot starve them.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "Calibration.h"
+#include "LockStats.h"
+
+class DelegationEventLoop {
+public:
+    using FdHandler = std::function<void(uint32_t events)>;
+    using TimerHandler = std::function<void(uint64_t expirations)>;
+
+private:
+    struct Task {
+        std::function<void()> work;
+        std::promise<void> completion;
+        uint64_t enqueuedNs;
+    };
+
+    struct Watch {
+        FdHandler onEvents;
+        TimerHandler onTimer; // Set for timers, which own their fd
+        bool oneShot = false;
+    };
+
+    static const int MAX_EVENTS = 64;
+
+    int epollFd = -1;
+    int wakeFd = -1;
+
+    std::mutex queueMutex;
+    std::vector<Task> queue;
+    std::atomic<size_t> pendingCount{0};
+    std::atomic<bool> running{true};
+    std::atomic<bool> sleeping{false};
+    std::atomic<bool> signalled{false}; // An eventfd write the server has not read yet
+    std::atomic<long> signals{0};
+    std::atomic<long> sleeps{0};
+
+    // Server-owned
+    std::unordered_map<int, Watch> watches;
+
+    lockstats::StatsWriter stats;
+    Calibration calib;
+    std::thread serverThread;
+
+    static std::system_error lastError(const char* what) {
+        return std::system_error(errno, std::generic_category(), what);
+    }
+
+    void signal() {
+        // Pairs with the fence in serve(): either we see it sleeping, or it
+        // sees our request before it blocks
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed) && !signalled.exchange(true)) {
+            uint64_t one = 1;
+            ssize_t n = write(wakeFd, &one, sizeof(one));
+            (void)n; // Only fails if the counter would overflow, which still wakes
+            signals++;
+        }
+    }
+
+    // Runs on the server
+    void unwatchNow(int fd) {
+        auto it = watches.find(fd);
+        if (it == watches.end()) return;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        if (it->second.onTimer) close(fd);
+        watches.erase(it);
+    }
+
+    void dispatch(const epoll_event& event) {
+        int fd = event.data.fd;
+        if (fd == wakeFd) {
+            uint64_t count;
+            ssize_t n = read(wakeFd, &count, sizeof(count));
+            (void)n;
+            signalled.store(false);
+            return;
+        }
+        auto it = watches.find(fd);
+        if (it == watches.end()) return; // Unwatched after the events were collected
+        Watch& w = it->second;
+        if (!w.onTimer) {
+            w.onEvents(event.events);
+            return;
+        }
+        uint64_t expirations = 0;
+        if (read(fd, &expirations, sizeof(expirations)) != (ssize_t)sizeof(expirations)) return;
+        w.onTimer(expirations);
+        if (w.oneShot) unwatchNow(fd);
+    }
+
+    // Returns the number of requests run
+    size_t runQueued(std::vector<Task>& batch, uint64_t startedNs) {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            batch.swap(queue);
+            pendingCount.store(0, std::memory_order_relaxed);
+        }
+        size_t depth = batch.size();
+        for (Task& task : batch) {
+            uint64_t begin = lockstats::nowNs();
+            task.work();
+            uint64_t end = lockstats::nowNs();
+            depth--;
+            stats.recordTask(depth > 0, begin - task.enqueuedNs, depth, end - begin, end - startedNs);
+            task.completion.set_value();
+        }
+        size_t ran = batch.size();
+        batch.clear();
+        return ran;
+    }
+
+    void serve() {
+        uint64_t startedNs = lockstats::nowNs();
+        std::vector<Task> batch;
+        epoll_event events[MAX_EVENTS];
+        for (;;) {
+            size_t ran = runQueued(batch, startedNs);
+            int n = 0;
+            if (ran > 0) {
+                n = epoll_wait(epollFd, events, MAX_EVENTS, 0);
+            } else {
+                if (!running && pendingCount.load() == 0) break; // Stopped and drained
+
+                // Spin briefly before sleeping: a request that arrives within
+                // about one wakeup's cost is cheaper to catch this way
+                SpinWait idle(calib.spinBeforePark, calib);
+                while (pendingCount.load(std::memory_order_acquire) == 0 && running && idle.spin()) {
+                }
+                sleeping.store(true, std::memory_order_seq_cst);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                bool idleNow = pendingCount.load(std::memory_order_relaxed) == 0 && running;
+                if (idleNow) sleeps++;
+                n = epoll_wait(epollFd, events, MAX_EVENTS, idleNow ? -1 : 0);
+                sleeping.store(false, std::memory_order_relaxed);
+            }
+            for (int i = 0; i < n; ++i) {
+                dispatch(events[i]);
+            }
+        }
+        for (auto& [fd, w] : watches) {
+            if (w.onTimer) close(fd);
+        }
+        watches.clear();
+    }
+
+public:
+    explicit DelegationEventLoop(const Calibration& c = hostCalibration())
+        : stats("delegation", "DelegationEventLoop"), calib(c) {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd < 0) throw lastError("epoll_create1");
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wakeFd < 0) {
+            close(epollFd);
+            throw lastError("eventfd");
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = wakeFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+        serverThread = std::thread(&DelegationEventLoop::serve, this);
+    }
+
+    // Runs the requests still queued, then stops. Watched descriptors are
+    // left open except timers'.
+    ~DelegationEventLoop() {
+        running = false;
+        uint64_t one = 1;
+        ssize_t n = write(wakeFd, &one, sizeof(one));
+        (void)n;
+        serverThread.join();
+        close(wakeFd);
+        close(epollFd);
+    }
+
+    DelegationEventLoop(const DelegationEventLoop&) = delete;
+    DelegationEventLoop& operator=(const DelegationEventLoop&) = delete;
+
+    std::future<void> async(std::function<void()> work) {
+        Task task;
+        task.work = std::move(work);
+        task.enqueuedNs = lockstats::nowNs();
+        auto fut = task.completion.get_future();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queue.push_back(std::move(task));
+            pendingCount.store(queue.size(), std::memory_order_release);
+        }
+        signal();
+        return fut;
+    }
+
+    // The registration calls below are requests too, so they are ordered with
+    // the caller's other requests. A handler may call them, but must not wait
+    // on their futures: it would be waiting on itself.
+
+    // Calls handler(events) on the server whenever fd is ready for events
+    // (EPOLLIN, EPOLLOUT, ...; level-triggered unless EPOLLET is given). The
+    // future throws std::system_error if fd cannot be watched.
+    std::future<void> watch(int fd, uint32_t events, FdHandler handler) {
+        auto done = std::make_shared<std::promise<void>>();
+        auto fut = done->get_future();
+        async([this, fd, events, handler = std::move(handler), done]() mutable {
+            epoll_event event{};
+            event.events = events;
+            event.data.fd = fd;
+            int op = watches.count(fd) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+            if (epoll_ctl(epollFd, op, fd, &event) != 0) {
+                done->set_exception(std::make_exception_ptr(lastError("epoll_ctl")));
+                return;
+            }
+            watches[fd].onEvents = std::move(handler);
+            done->set_value();
+        });
+        return fut;
+    }
+
+    // Stops watching fd; handler calls for events already collected are
+    // skipped. The caller still owns fd.
+    std::future<void> unwatch(int fd) {
+        return async([this, fd] { unwatchNow(fd); });
+    }
+
+    // Calls handler(expirations) on the server after first, then every
+    // period (zero: once, after which the timer is removed). The future holds
+    // the timer's id, or throws std::system_error.
+    std::future<int> addTimer(std::chrono::nanoseconds first, std::chrono::nanoseconds period,
+                              TimerHandler handler) {
+        auto done = std::make_shared<std::promise<int>>();
+        auto fut = done->get_future();
+        async([this, first, period, handler = std::move(handler), done]() mutable {
+            int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            if (fd < 0) {
+                done->set_exception(std::make_exception_ptr(lastError("timerfd_create")));
+                return;
+            }
+            auto toSpec = [](std::chrono::nanoseconds d) {
+                return timespec{(time_t)(d.count() / 1000000000), (long)(d.count() % 1000000000)};
+            };
+            itimerspec spec{toSpec(period), toSpec(std::max(first, std::chrono::nanoseconds(1)))};
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (timerfd_settime(fd, 0, &spec, nullptr) != 0 ||
+                epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                done->set_exception(std::make_exception_ptr(lastError("timerfd")));
+                close(fd);
+                return;
+            }
+            Watch& w = watches[fd];
+            w.onTimer = std::move(handler);
+            w.oneShot = period.count() == 0;
+            done->set_value(fd);
+        });
+        return fut;
+    }
+
+    // Do not cancel a one-shot timer that may have fired: it is removed
+    // when it fires, and its id may by then belong to another descriptor.
+    std::future<void> cancelTimer(int id) {
+        return unwatch(id);
+    }
+
+    // eventfd writes by clients, and times the server went to sleep. With
+    // coalescing the first tracks the second, not the number of requests.
+    long signalCount() const { return signals.load(); }
+    long sleepCount() const { return sleeps.load(); }
+};
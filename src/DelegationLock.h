@@ -0,0 +1,524 @@
+#pragma once
+
+#include <thread>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <vector>
+#include <chrono>
+#include <optional>
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include "Calibration.h"
+#include "DurableLog.h"
+#include "LockStats.h"
+#include "Placement.h"
+
+// Request classes for DelegationLock, most urgent first.
+enum class Priority { High = 0, Normal = 1, Bulk = 2 };
+
+// How the DelegationLock server picks the next request among its lanes.
+enum class LaneScheduling {
+    StrictPriority,  // Most urgent non-empty lane; a lane passed over too often goes next
+    EarliestDeadline // Earliest deadline over all lanes; undated requests get a class budget
+};
+
+// What a bounded DelegationLock does with a request that finds it full.
+enum class OverflowPolicy {
+    Block,     // Spin, then park the producer until the server frees a slot
+    Reject,    // Fail the request at once
+    ShedLowest // Evict the least urgent queued request if it is less urgent
+               // than the new one, else reject the new one
+};
+
+// Stored in the future of a request that was rejected or shed.
+struct DelegationOverflow : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// Stored in the future of a logged request that could not be made durable:
+// no log, a full log, an oversized record, or a failed sync. Not
+// backpressure, so not a DelegationOverflow.
+struct DelegationLogError : std::system_error {
+    using std::system_error::system_error;
+};
+
+class DelegationLock {
+private:
+    struct Task {
+        std::function<void()> work;
+        std::vector<std::function<void()>> batch; // Run after work, in order
+        std::promise<void> completion;
+        uint64_t enqueuedNs;
+        uint64_t deadlineNs;
+        uint64_t seq; // Arrival order, breaks deadline ties
+        bool logged = false;
+        std::string record; // Appended to the durable log before work runs
+    };
+
+    static const int LANE_COUNT = 3;
+
+    // Implicit deadline of undated requests, relative to arrival, per lane
+    static constexpr uint64_t LANE_BUDGET_NS[LANE_COUNT] = {0, 1000000, 10000000};
+
+    // One min-heap per Priority, ordered by (deadline, arrival). Undated
+    // requests in a lane share a budget, so a lane is FIFO unless callers
+    // give deadlines.
+    std::vector<Task> lanes[LANE_COUNT];
+    int passedOver[LANE_COUNT] = {};
+    uint64_t nextSeq = 0;
+    LaneScheduling scheduling = LaneScheduling::StrictPriority;
+    int starvationLimit = 64;
+    std::atomic<size_t> pendingCount{0}; // Tasks in all lanes, readable without the mutex
+    std::atomic<size_t> capacityLimit{0}; // 0: unbounded
+    std::atomic<OverflowPolicy> overflowPolicy{OverflowPolicy::Block};
+    int blockedProducers = 0;
+    std::atomic<long> rejected{0};
+    std::atomic<long> shed{0};
+    std::mutex queueMutex;
+    std::condition_variable queueCV;
+    std::condition_variable spaceCV;      // Producers blocked on a full queue
+
+    // Group commit, guarded by queueMutex
+    durablelog::LogFile* durableLog = nullptr;
+    size_t logBatch = 64;
+    uint64_t logDelayNs = 0;
+    std::thread workerThread;
+    std::atomic<bool> running;
+    lockstats::StatsWriter stats;
+    int serverCpu;
+    Calibration calib;
+
+    static bool later(const Task& a, const Task& b) {
+        return a.deadlineNs != b.deadlineNs ? a.deadlineNs > b.deadlineNs : a.seq > b.seq;
+    }
+
+    // Called with queueMutex held and at least one task queued.
+    int pickLane() {
+        int chosen = -1;
+        if (scheduling == LaneScheduling::EarliestDeadline) {
+            for (int l = 0; l < LANE_COUNT; ++l) {
+                if (!lanes[l].empty() && (chosen < 0 || later(lanes[chosen].front(), lanes[l].front()))) {
+                    chosen = l;
+                }
+            }
+            return chosen;
+        }
+
+        // Bounded starvation: the least urgent lane over the limit goes first
+        for (int l = LANE_COUNT - 1; l >= 0 && chosen < 0; --l) {
+            if (!lanes[l].empty() && passedOver[l] >= starvationLimit) chosen = l;
+        }
+        for (int l = 0; l < LANE_COUNT && chosen < 0; ++l) {
+            if (!lanes[l].empty()) chosen = l;
+        }
+        passedOver[chosen] = 0;
+        for (int l = chosen + 1; l < LANE_COUNT; ++l) {
+            if (!lanes[l].empty()) passedOver[l]++;
+        }
+        return chosen;
+    }
+
+    // Completions held back until the durable log is synced. Once a logged
+    // request is held, later ones wait too, so nobody sees an effect before
+    // it is durable. If the sync fails, every held future throws
+    // DelegationLogError: the work has run, but is not known to be durable.
+    struct HeldCompletions {
+        std::vector<std::promise<void>> promises;
+        uint64_t sinceNs = 0;
+
+        void commit(durablelog::LogFile* log) {
+            if (!log || log->sync()) {
+                for (auto& p : promises) p.set_value();
+            } else {
+                auto failure = std::make_exception_ptr(DelegationLogError(
+                    errno, std::generic_category(), "DelegationLock: durable log sync failed"));
+                for (auto& p : promises) p.set_exception(failure);
+            }
+            promises.clear();
+        }
+    };
+
+    void worker() {
+        if (serverCpu >= 0) {
+            pinCurrentThread(serverCpu);
+        }
+        uint64_t startedNs = lockstats::nowNs();
+        HeldCompletions held;
+        durablelog::LogFile* log = nullptr;
+        size_t batchLimit = 0;
+        uint64_t delayNs = 0;
+        while (running) {
+            // Group commit: sync when the batch is full, when the oldest held
+            // request has waited the maximum delay, or with no delay set,
+            // whenever the queue drains
+            if (!held.promises.empty() &&
+                (held.promises.size() >= batchLimit ||
+                 (delayNs > 0 ? lockstats::nowNs() - held.sinceNs >= delayNs
+                              : pendingCount.load(std::memory_order_acquire) == 0))) {
+                held.commit(log);
+            }
+
+            // Spin briefly before parking: a request that arrives within
+            // about one wakeup's cost is cheaper to catch this way
+            SpinWait idle(calib.spinBeforePark, calib);
+            while (pendingCount.load(std::memory_order_acquire) == 0 && running && idle.spin()) {
+            }
+
+            std::unique_lock<std::mutex> lock(queueMutex);
+            auto ready = [this] { return pendingCount.load() > 0 || !running; };
+            if (held.promises.empty()) {
+                queueCV.wait(lock, ready);
+            } else if (!queueCV.wait_for(lock, std::chrono::nanoseconds(
+                           held.sinceNs + delayNs - std::min(lockstats::nowNs(), held.sinceNs + delayNs)),
+                       ready)) {
+                continue; // Commit window closed
+            }
+
+            if (!running) break;
+
+            std::vector<Task>& lane = lanes[pickLane()];
+            std::pop_heap(lane.begin(), lane.end(), later);
+            Task task = std::move(lane.back());
+            lane.pop_back();
+            size_t pending = pendingCount.load(std::memory_order_relaxed) - 1;
+            pendingCount.store(pending, std::memory_order_relaxed);
+            if (blockedProducers > 0) {
+                spaceCV.notify_one();
+            }
+            if (log != durableLog && !held.promises.empty()) {
+                held.commit(log); // Log switched: finish the old one's batch
+            }
+            log = durableLog;
+            batchLimit = logBatch;
+            delayNs = logDelayNs;
+            lock.unlock();
+
+            // Write ahead: a request that cannot be logged does not run
+            if (task.logged) {
+                if (!log || !log->append(task.record.data(), task.record.size())) {
+                    if (log) failLog(task, std::errc::no_space_on_device, "DelegationLock: durable log full");
+                    else failLog(task, std::errc::no_such_file_or_directory, "DelegationLock: no durable log");
+                    continue;
+                }
+            }
+
+            // Execute the critical section work
+            uint64_t begin = lockstats::nowNs();
+            if (task.work) {
+                task.work();
+            }
+            for (auto& work : task.batch) {
+                work();
+            }
+            uint64_t end = lockstats::nowNs();
+
+            // The server is the only writer of its stats slot
+            stats.recordTask(pending > 0, begin - task.enqueuedNs, pending,
+                             end - begin, end - startedNs);
+
+            // Notify completion, after the log sync if one is pending
+            if (task.logged || !held.promises.empty()) {
+                if (held.promises.empty()) held.sinceNs = end;
+                held.promises.push_back(std::move(task.completion));
+            } else {
+                task.completion.set_value();
+            }
+        }
+        held.commit(log);
+    }
+
+public:
+    // serverCpu pins the server thread; -1 leaves placement to the scheduler.
+    explicit DelegationLock(int serverCpu = -1, const Calibration& c = hostCalibration())
+        : running(true), stats("delegation", "DelegationLock"), serverCpu(serverCpu), calib(c) {
+        workerThread = std::thread(&DelegationLock::worker, this);
+    }
+
+    ~DelegationLock() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            running = false;
+        }
+        queueCV.notify_one();
+        if (workerThread.joinable()) {
+            workerThread.join();
+        }
+    }
+
+    // On a full queue this follows the overflow policy; a rejected or shed
+    // request's future throws DelegationOverflow.
+    std::future<void> async(std::function<void()> work, Priority priority = Priority::Normal) {
+        Task task;
+        task.work = std::move(work);
+        auto fut = task.completion.get_future();
+        enqueue(std::move(task), priority, 0, true);
+        return fut;
+    }
+
+    // Never blocks: returns nothing if the request was not admitted. Under
+    // ShedLowest it may still evict a less urgent request to get in.
+    std::optional<std::future<void>> tryAsync(std::function<void()> work,
+                                              Priority priority = Priority::Normal) {
+        Task task;
+        task.work = std::move(work);
+        auto fut = task.completion.get_future();
+        if (!enqueue(std::move(task), priority, 0, false)) {
+            return std::nullopt;
+        }
+        return fut;
+    }
+
+    // A dated request: ordered by its deadline within its lane, and across
+    // lanes when scheduling by earliest deadline.
+    std::future<void> async(std::function<void()> work, std::chrono::steady_clock::time_point deadline,
+                            Priority priority = Priority::Normal) {
+        Task task;
+        task.work = std::move(work);
+        auto fut = task.completion.get_future();
+        uint64_t deadlineNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            deadline.time_since_epoch()).count();
+        enqueue(std::move(task), priority, std::max<uint64_t>(deadlineNs, 1), true);
+        return fut;
+    }
+
+    // Bounds the queue to capacity requests over all lanes (0: unbounded).
+    // Producers blocked by a smaller bound are woken as the server drains.
+    void setCapacity(size_t capacity, OverflowPolicy policy = OverflowPolicy::Block) {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        capacityLimit = capacity;
+        overflowPolicy = policy;
+        spaceCV.notify_all();
+    }
+
+    // Makes requests submitted with asyncLogged() durable in log (nullptr
+    // detaches it). The server syncs once per batch: after maxBatch requests,
+    // once the oldest unsynced one has waited maxDelay, or with maxDelay 0
+    // whenever its queue drains. Their futures complete only after the sync.
+    //
+    // Returns once the server has committed what it held for the previous
+    // log and let go of it, so that log may then be destroyed. Must not be
+    // called from a request: the server would be waiting on itself.
+    void setDurableLog(durablelog::LogFile* log, size_t maxBatch = 64,
+                       std::chrono::microseconds maxDelay = std::chrono::microseconds(0)) {
+        std::future<void> switched;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            durableLog = log;
+            logBatch = std::max<size_t>(maxBatch, 1);
+            logDelayNs = std::chrono::duration_cast<std::chrono::nanoseconds>(maxDelay).count();
+
+            // An empty request, past any capacity bound: the server takes up
+            // the new log when it dequeues the next request, this one at the
+            // latest
+            Task marker;
+            marker.enqueuedNs = lockstats::nowNs();
+            marker.deadlineNs = marker.enqueuedNs;
+            marker.seq = nextSeq++;
+            switched = marker.completion.get_future();
+            std::vector<Task>& lane = lanes[static_cast<int>(Priority::High)];
+            lane.push_back(std::move(marker));
+            std::push_heap(lane.begin(), lane.end(), later);
+            pendingCount.store(pendingCount.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+        queueCV.notify_one();
+        switched.wait();
+    }
+
+    // Appends record to the durable log, then runs work; the future
+    // completes once the record is durable. It throws DelegationLogError if
+    // the log is missing or full or the record is longer than
+    // durablelog::MAX_RECORD_LENGTH, in which case work does not run, and
+    // DelegationOverflow if the queue turned the request away.
+    std::future<void> asyncLogged(std::string record, std::function<void()> work,
+                                  Priority priority = Priority::Normal) {
+        Task task;
+        task.work = std::move(work);
+        task.logged = true;
+        task.record = std::move(record);
+        auto fut = task.completion.get_future();
+        if (task.record.size() > durablelog::MAX_RECORD_LENGTH) {
+            failLog(task, std::errc::message_size, "DelegationLock: durable log record too large");
+            return fut;
+        }
+        enqueue(std::move(task), priority, 0, true);
+        return fut;
+    }
+
+    // Occupancy, for callers that shed load themselves.
+    size_t queueDepth() const { return pendingCount.load(std::memory_order_relaxed); }
+    size_t capacity() const { return capacityLimit.load(); }
+    long rejectedCount() const { return rejected.load(); }
+    long shedCount() const { return shed.load(); }
+
+    // starvationLimit: in StrictPriority mode, how many times a waiting lane
+    // may be passed over for a more urgent one before it is served.
+    void setScheduling(LaneScheduling mode, int limit = 64) {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        scheduling = mode;
+        starvationLimit = std::max(limit, 1);
+    }
+
+    // Submits several operations as one request: one queue push, one wakeup,
+    // and one completion once the server has run all of them in order.
+    std::future<void> asyncBatch(std::vector<std::function<void()>> works) {
+        std::promise<void> completion;
+        auto fut = completion.get_future();
+        asyncBatch(std::move(works), std::move(completion));
+        return fut;
+    }
+
+    // As above, completing a promise the caller created beforehand.
+    void asyncBatch(std::vector<std::function<void()>> works, std::promise<void> completion) {
+        Task task;
+        task.batch = std::move(works);
+        task.completion = std::move(completion);
+        enqueue(std::move(task), Priority::Normal, 0, true);
+    }
+
+private:
+    bool full() const {
+        size_t limit = capacityLimit.load(std::memory_order_relaxed);
+        return limit > 0 && pendingCount.load(std::memory_order_relaxed) >= limit;
+    }
+
+    static void fail(Task& task, const char* why) {
+        task.completion.set_exception(std::make_exception_ptr(DelegationOverflow(why)));
+    }
+
+    static void failLog(Task& task, std::errc code, const char* why) {
+        task.completion.set_exception(std::make_exception_ptr(DelegationLogError(std::make_error_code(code), why)));
+    }
+
+    // Called with queueMutex held on a full queue. Evicts the latest request
+    // of the least urgent lane below lane l, if there is one.
+    bool shedBelow(int l) {
+        for (int victim = LANE_COUNT - 1; victim > l; --victim) {
+            std::vector<Task>& lane = lanes[victim];
+            if (lane.empty()) continue;
+            auto last = std::min_element(lane.begin(), lane.end(), later);
+            Task evicted = std::move(*last);
+            *last = std::move(lane.back());
+            lane.pop_back();
+            std::make_heap(lane.begin(), lane.end(), later);
+            pendingCount.store(pendingCount.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+            fail(evicted, "DelegationLock: request shed for a more urgent one");
+            shed++;
+            return true;
+        }
+        return false;
+    }
+
+    // deadlineNs 0 means undated: the lane budget applies. Returns whether
+    // the request was admitted; if not, its promise holds DelegationOverflow.
+    bool enqueue(Task&& task, Priority priority, uint64_t deadlineNs, bool mayBlock) {
+        int l = static_cast<int>(priority);
+        task.enqueuedNs = lockstats::nowNs();
+        task.deadlineNs = deadlineNs ? deadlineNs : task.enqueuedNs + LANE_BUDGET_NS[l];
+
+        if (mayBlock && overflowPolicy == OverflowPolicy::Block && full()) {
+            // Waiting here is cheaper than a park/unpark pair if the server
+            // frees a slot within about one wakeup's cost
+            SpinWait wait(calib.spinBeforePark, calib);
+            while (full() && wait.spin()) {
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(queueMutex);
+        if (full()) {
+            bool admitted = false;
+            if (overflowPolicy == OverflowPolicy::Block && mayBlock) {
+                blockedProducers++;
+                spaceCV.wait(lock, [this] { return !full(); });
+                blockedProducers--;
+                admitted = true;
+            } else if (overflowPolicy == OverflowPolicy::ShedLowest) {
+                admitted = shedBelow(l);
+            }
+            if (!admitted) {
+                lock.unlock();
+                fail(task, "DelegationLock: queue full");
+                rejected++;
+                return false;
+            }
+        }
+        task.seq = nextSeq++;
+        lanes[l].push_back(std::move(task));
+        std::push_heap(lanes[l].begin(), lanes[l].end(), later);
+        pendingCount.store(pendingCount.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        queueCV.notify_one();
+        return true;
+    }
+};
+
+// Client-side accumulator for DelegationLock::asyncBatch. Each client thread
+// owns one, so the buffer is thread-local and needs no synchronisation.
+// The batch is submitted when it reaches maxOps, when add() or poll() finds
+// its oldest operation older than maxDelay, or on flush().
+class DelegationBatcher {
+private:
+    DelegationLock& lock;
+    size_t maxOps;
+    uint64_t maxDelayNs;
+    std::vector<std::function<void()>> buffer;
+    std::promise<void> completion;
+    std::shared_future<void> batchFuture;
+    uint64_t oldestNs = 0;
+
+public:
+    DelegationBatcher(DelegationLock& l, size_t maxOps,
+                      std::chrono::nanoseconds maxDelay = std::chrono::microseconds(100))
+        : lock(l), maxOps(maxOps > 0 ? maxOps : 1), maxDelayNs(maxDelay.count()) {
+        buffer.reserve(this->maxOps);
+    }
+
+    ~DelegationBatcher() {
+        flush();
+    }
+
+    DelegationBatcher(const DelegationBatcher&) = delete;
+    DelegationBatcher& operator=(const DelegationBatcher&) = delete;
+
+    // Buffers work; the returned future completes with the batch it joined.
+    std::shared_future<void> add(std::function<void()> work) {
+        if (buffer.empty()) {
+            completion = std::promise<void>();
+            batchFuture = completion.get_future().share();
+            oldestNs = lockstats::nowNs();
+        }
+        buffer.push_back(std::move(work));
+        std::shared_future<void> fut = batchFuture;
+        if (buffer.size() >= maxOps) {
+            flush();
+        } else {
+            poll();
+        }
+        return fut;
+    }
+
+    // Submits the batch if its oldest operation has waited past maxDelay.
+    void poll() {
+        if (!buffer.empty() && lockstats::nowNs() - oldestNs >= maxDelayNs) {
+            flush();
+        }
+    }
+
+    // Submits whatever is buffered; returns the future of that batch (or of
+    // the last one submitted if the buffer was empty; invalid if none was).
+    std::shared_future<void> flush() {
+        if (!buffer.empty()) {
+            lock.asyncBatch(std::move(buffer), std::move(completion));
+            buffer.clear();
+            buffer.reserve(maxOps);
+        }
+        return batchFuture;
+    }
+
+    size_t pending() const { return buffer.size(); }
+};
@@ -0,0 +1,177 @@
+#pragma once
+
+// A chain of delegation servers, each owning one piece of state.
+//
+// A request is a Message that visits every stage in turn: stage i runs its
+// handler on the message and hands it to stage i + 1 through a bounded ring,
+// and the last stage completes the client's future. Clients only talk to
+// the first stage, and the stages work on different requests at once.
+//
+// Each stage takes up to `batch` messages from its ring per round, runs
+// them, and forwards them with one wakeup of the next stage. A full ring
+// holds its producer back, so a slow stage pushes back to the clients.
+// Every stage records rounds in its own stats slot ("pipeline" kind, named
+// after the stage), and stageDepth() reports the depth of its input ring.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Calibration.h"
+#include "LockStats.h"
+#include "SpscRing.h"
+
+template <typename Message>
+class DelegationPipeline {
+public:
+    using Handler = std::function<void(Message&)>;
+
+    struct StageSpec {
+        std::string name;
+        Handler handler;  // Runs on the stage's thread only
+        size_t batch = 32;
+    };
+
+private:
+    struct Envelope {
+        Message message;
+        std::promise<Message> done;
+        uint64_t enteredNs = 0; // When it entered the current stage's ring
+    };
+
+    struct Stage {
+        StageSpec spec;
+        SpscRing<Envelope> input;
+        std::atomic<bool> upstreamDone{false};
+        std::atomic<bool> sleeping{false};
+        std::mutex sleepMutex;
+        std::condition_variable sleepCV;
+        lockstats::StatsWriter stats;
+        std::thread thread;
+
+        Stage(StageSpec s, size_t capacity)
+            : spec(std::move(s)), input(capacity), stats("pipeline", spec.name.c_str()) {}
+    };
+
+    std::vector<std::unique_ptr<Stage>> stages;
+    std::mutex submitMutex; // Clients share the first ring's producer side
+    Calibration calib;
+
+    void wake(Stage& s) {
+        // Pairs with the fence in run(): either we see it sleeping, or it
+        // sees the message before it blocks
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (s.sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(s.sleepMutex);
+            s.sleepCV.notify_one();
+        }
+    }
+
+    void push(Stage& s, Envelope& e) {
+        e.enteredNs = lockstats::nowNs();
+        SpinWait full(calib.spinBeforeYield, calib);
+        while (!s.input.tryPush(e)) {
+            wake(s); // It may have parked before this batch began
+            full.once(); // Backpressure from a slower stage
+        }
+    }
+
+    void run(size_t index) {
+        Stage& stage = *stages[index];
+        Stage* next = index + 1 < stages.size() ? stages[index + 1].get() : nullptr;
+        std::vector<Envelope> batch(stage.spec.batch);
+        uint64_t startedNs = lockstats::nowNs();
+
+        for (;;) {
+            SpinWait idle(calib.spinBeforePark, calib);
+            while (stage.input.empty() && idle.spin()) {
+            }
+            if (stage.input.empty()) {
+                std::unique_lock<std::mutex> lock(stage.sleepMutex);
+                stage.sleeping.store(true, std::memory_order_seq_cst);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                stage.sleepCV.wait(lock, [&] { return !stage.input.empty() || stage.upstreamDone.load(); });
+                stage.sleeping.store(false, std::memory_order_relaxed);
+            }
+            if (stage.input.empty()) return; // Upstream finished and drained
+
+            size_t depth = stage.input.size();
+            size_t n = 0;
+            while (n < batch.size() && stage.input.tryPop(batch[n])) {
+                n++;
+            }
+            uint64_t begin = lockstats::nowNs();
+            for (size_t i = 0; i < n; ++i) {
+                stage.spec.handler(batch[i].message);
+            }
+            uint64_t end = lockstats::nowNs();
+            stage.stats.recordTask(depth > n, begin - batch[0].enteredNs, depth, end - begin,
+                                   end - startedNs);
+
+            for (size_t i = 0; i < n; ++i) {
+                if (next) {
+                    push(*next, batch[i]);
+                } else {
+                    batch[i].done.set_value(std::move(batch[i].message));
+                }
+            }
+            if (next) {
+                wake(*next);
+            }
+        }
+    }
+
+public:
+    // Needs at least one stage. ringCapacity: messages each stage's input
+    // ring holds. Message must be default-constructible and movable.
+    explicit DelegationPipeline(std::vector<StageSpec> specs, size_t ringCapacity = 256,
+                                const Calibration& c = hostCalibration())
+        : calib(c) {
+        for (auto& spec : specs) {
+            spec.batch = std::max<size_t>(spec.batch, 1);
+            stages.emplace_back(new Stage(std::move(spec), ringCapacity));
+        }
+        for (size_t i = 0; i < stages.size(); ++i) {
+            stages[i]->thread = std::thread(&DelegationPipeline::run, this, i);
+        }
+    }
+
+    // Stops the stages front to back, each after draining what it holds.
+    ~DelegationPipeline() {
+        for (auto& stage : stages) {
+            {
+                std::lock_guard<std::mutex> lock(stage->sleepMutex);
+                stage->upstreamDone = true;
+            }
+            stage->sleepCV.notify_one();
+            stage->thread.join();
+        }
+    }
+
+    DelegationPipeline(const DelegationPipeline&) = delete;
+    DelegationPipeline& operator=(const DelegationPipeline&) = delete;
+
+    // Sends message through every stage; the future holds it after the last.
+    std::future<Message> submit(Message message) {
+        Envelope e;
+        e.message = std::move(message);
+        auto fut = e.done.get_future();
+        {
+            std::lock_guard<std::mutex> lock(submitMutex);
+            push(*stages.front(), e);
+        }
+        wake(*stages.front());
+        return fut;
+    }
+
+    int stageCount() const { return (int)stages.size(); }
+    const std::string& stageName(int stage) const { return stages[stage]->spec.name; }
+    size_t stageDepth(int stage) const { return stages[stage]->input.size(); }
+};
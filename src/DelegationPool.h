@@ -0,0 +1,321 @@
+#pragma once
+
+// Many delegated objects multiplexed onto a pool of server threads.
+//
+// Each object is a Mailbox with its own request queue. Mailboxes are grouped
+// into shards, and every shard is owned by one server. A mailbox with pending
+// work is scheduled on the run queue of its shard's owner; only one server
+// runs it at a time, one batch at a time, so the object's state stays in one
+// cache as with a dedicated DelegationLock server, without a thread per
+// object.
+//
+// The pool can be elastic: a controller adds servers when they are busy or
+// their run queues grow, and retires them when they are mostly idle. Shards
+// of a retiring server move to the remaining ones first; the server then
+// drains its run queue before exiting, and the mailboxes it ran reschedule on
+// their new owners.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Calibration.h"
+#include "LockStats.h"
+
+struct ElasticConfig {
+    int minServers = 1;
+    int maxServers = 4;
+    std::chrono::milliseconds interval{10};  // How often the controller looks
+    double scaleUpUtilisation = 0.75;        // Mean busy fraction that adds a server
+    double scaleDownUtilisation = 0.25;      // Mean busy fraction that retires one
+    size_t scaleUpDepth = 8;                 // Mean run-queue length that adds a server
+};
+
+class DelegationPool {
+public:
+    static const int SHARD_COUNT = 256;
+
+    class Mailbox {
+    private:
+        friend class DelegationPool;
+
+        struct Task {
+            std::function<void()> work;
+            std::promise<void> completion;
+        };
+
+        DelegationPool& pool;
+        int shard;
+        std::mutex queueMutex;   // Guards tasks and scheduled
+        std::vector<Task> tasks;
+        bool scheduled = false;  // In a run queue or being run
+
+        Mailbox(DelegationPool& p, int shardIndex) : pool(p), shard(shardIndex) {}
+
+    public:
+        // The mailbox must have no pending requests when it is destroyed.
+        std::future<void> async(std::function<void()> work) {
+            Task task;
+            task.work = std::move(work);
+            auto fut = task.completion.get_future();
+
+            bool needSchedule;
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                tasks.push_back(std::move(task));
+                needSchedule = !scheduled;
+                scheduled = true;
+            }
+            if (needSchedule) {
+                pool.schedule(this);
+            }
+            return fut;
+        }
+    };
+
+private:
+    struct Server {
+        std::mutex runMutex;
+        std::condition_variable runCV;
+        std::deque<Mailbox*> runQueue;
+        std::atomic<size_t> queued{0};     // runQueue.size(), readable without the mutex
+        bool retiring = false;             // Guarded by runMutex
+        bool retired = true;               // Guarded by runMutex; not accepting work
+        std::atomic<uint64_t> busyNs{0};
+        std::thread thread;
+        lockstats::StatsWriter stats;
+
+        Server(const std::string& name) : stats("pool", name.c_str()) {}
+    };
+
+    ElasticConfig config;
+    Calibration calib;
+    std::vector<std::unique_ptr<Server>> servers; // maxServers slots
+    std::atomic<int> shardOwner[SHARD_COUNT];
+    std::atomic<unsigned> nextShard{0};
+    std::atomic<int> active{0};
+    std::atomic<long> scaleEvents{0};
+    std::atomic<bool> running{true};
+
+    std::mutex controlMutex;
+    std::condition_variable controlCV;
+    std::thread controller;
+
+    void schedule(Mailbox* mailbox) {
+        for (;;) {
+            Server& server = *servers[shardOwner[mailbox->shard].load(std::memory_order_acquire)];
+            {
+                std::lock_guard<std::mutex> lock(server.runMutex);
+                if (!server.retired) {
+                    server.runQueue.push_back(mailbox);
+                    server.queued.store(server.runQueue.size(), std::memory_order_release);
+                    server.runCV.notify_one();
+                    return;
+                }
+            }
+            // Raced with the shard moving off a retiring server: look again
+            std::this_thread::yield();
+        }
+    }
+
+    void serve(int id) {
+        Server& server = *servers[id];
+        std::vector<Mailbox::Task> batch;
+        uint64_t startedNs = lockstats::nowNs();
+
+        for (;;) {
+            SpinWait idle(calib.spinBeforePark, calib);
+            while (server.queued.load(std::memory_order_acquire) == 0 && running && idle.spin()) {
+            }
+
+            Mailbox* mailbox;
+            size_t depth;
+            {
+                std::unique_lock<std::mutex> lock(server.runMutex);
+                server.runCV.wait(lock, [&] {
+                    return !server.runQueue.empty() || !running || server.retiring;
+                });
+                if (server.runQueue.empty()) {
+                    server.retired = true; // Stopped or retired, and drained
+                    return;
+                }
+                mailbox = server.runQueue.front();
+                server.runQueue.pop_front();
+                depth = server.runQueue.size();
+                server.queued.store(depth, std::memory_order_relaxed);
+            }
+
+            // Run what the mailbox holds now; later arrivals wait for the
+            // next turn so one busy object cannot starve the others
+            {
+                std::lock_guard<std::mutex> lock(mailbox->queueMutex);
+                batch.swap(mailbox->tasks);
+            }
+            uint64_t begin = lockstats::nowNs();
+            for (auto& task : batch) {
+                task.work();
+            }
+            uint64_t end = lockstats::nowNs();
+            server.busyNs.fetch_add(end - begin, std::memory_order_relaxed);
+            server.stats.recordTask(depth > 0, 0, depth, end - begin, end - startedNs);
+
+            // Done with the mailbox before completing anything: once the last
+            // future is ready its owner may destroy it
+            bool again;
+            {
+                std::lock_guard<std::mutex> lock(mailbox->queueMutex);
+                again = !mailbox->tasks.empty();
+                mailbox->scheduled = again;
+            }
+            for (auto& task : batch) {
+                task.completion.set_value();
+            }
+            batch.clear();
+            if (again) {
+                schedule(mailbox); // Possibly on a new owner
+            }
+        }
+    }
+
+    void assignShards(int serverCount) {
+        for (int s = 0; s < SHARD_COUNT; ++s) {
+            shardOwner[s].store(s % serverCount, std::memory_order_release);
+        }
+    }
+
+    void startServer(int id) {
+        Server& server = *servers[id];
+        {
+            std::lock_guard<std::mutex> lock(server.runMutex);
+            server.retiring = false;
+            server.retired = false;
+        }
+        server.thread = std::thread(&DelegationPool::serve, this, id);
+    }
+
+    void stopServer(int id) {
+        Server& server = *servers[id];
+        {
+            std::lock_guard<std::mutex> lock(server.runMutex);
+            server.retiring = true;
+        }
+        server.runCV.notify_all();
+        server.thread.join();
+    }
+
+    void addServer() {
+        int n = active.load();
+        startServer(n);
+        assignShards(n + 1);
+        active = n + 1;
+        scaleEvents++;
+    }
+
+    // Shards move first, so only the draining server still sees its queue
+    void removeServer() {
+        int n = active.load() - 1;
+        assignShards(n);
+        active = n;
+        stopServer(n);
+        scaleEvents++;
+    }
+
+    void control() {
+        std::vector<uint64_t> lastBusy(servers.size(), 0);
+        uint64_t last = lockstats::nowNs();
+        bool cooldown = false;
+
+        std::unique_lock<std::mutex> lock(controlMutex);
+        while (!controlCV.wait_for(lock, config.interval, [this] { return !running; })) {
+            uint64_t now = lockstats::nowNs();
+            double elapsed = double(now - last);
+            int n = active.load();
+            double utilisation = 0;
+            double depth = 0;
+            for (int i = 0; i < n; ++i) {
+                uint64_t busy = servers[i]->busyNs.load(std::memory_order_relaxed);
+                utilisation += (busy - lastBusy[i]) / elapsed;
+                depth += servers[i]->queued.load(std::memory_order_relaxed);
+            }
+            utilisation /= n;
+            depth /= n;
+
+            // Skip one interval after a change so its effect is measured
+            if (!cooldown) {
+                if ((utilisation > config.scaleUpUtilisation || depth > config.scaleUpDepth) &&
+                    n < config.maxServers) {
+                    addServer();
+                    cooldown = true;
+                } else if (utilisation < config.scaleDownUtilisation && n > config.minServers) {
+                    removeServer();
+                    cooldown = true;
+                }
+            } else {
+                cooldown = false;
+            }
+
+            for (size_t i = 0; i < servers.size(); ++i) {
+                lastBusy[i] = servers[i]->busyNs.load(std::memory_order_relaxed);
+            }
+            last = lockstats::nowNs();
+        }
+    }
+
+public:
+    // A fixed pool of serverCount servers.
+    explicit DelegationPool(int serverCount, const Calibration& c = hostCalibration())
+        : DelegationPool(ElasticConfig{serverCount, serverCount}, c) {}
+
+    // An elastic pool starting at minServers.
+    explicit DelegationPool(const ElasticConfig& cfg, const Calibration& c = hostCalibration())
+        : config(cfg), calib(c) {
+        config.minServers = std::max(config.minServers, 1);
+        config.maxServers = std::max(config.maxServers, config.minServers);
+        for (int i = 0; i < config.maxServers; ++i) {
+            servers.emplace_back(new Server("DelegationPool server " + std::to_string(i)));
+        }
+        for (int i = 0; i < config.minServers; ++i) {
+            startServer(i);
+        }
+        assignShards(config.minServers);
+        active = config.minServers;
+        if (config.maxServers > config.minServers) {
+            controller = std::thread(&DelegationPool::control, this);
+        }
+    }
+
+    ~DelegationPool() {
+        {
+            std::lock_guard<std::mutex> lock(controlMutex);
+            running = false;
+        }
+        controlCV.notify_all();
+        if (controller.joinable()) {
+            controller.join();
+        }
+        for (int i = active.load() - 1; i >= 0; --i) {
+            stopServer(i);
+        }
+    }
+
+    DelegationPool(const DelegationPool&) = delete;
+    DelegationPool& operator=(const DelegationPool&) = delete;
+
+    // New objects are spread round-robin over the shards.
+    std::unique_ptr<Mailbox> createMailbox() {
+        int shard = nextShard++ % SHARD_COUNT;
+        return std::unique_ptr<Mailbox>(new Mailbox(*this, shard));
+    }
+
+    int serverCount() const { return active.load(); }
+    long scaleEventCount() const { return scaleEvents.load(); }
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+// Closed-world delegation: the set of operations is fixed at compile time.
+//
+// Requests are stored by value as std::variant<Ops...> in the cells of a
+// bounded multi-producer ring, and the server dispatches them with a switch
+// on the variant index generated from the operation list. Every case calls a
+// statically known operator(), so the compiler can inline each operation
+// into the server loop; there is no std::function, no indirect call and no
+// per-request allocation.
+//
+// Each operation is a struct with `long operator()(State&)`.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "Calibration.h"
+
+template <typename State, typename... Ops>
+class DelegationServer {
+public:
+    using Request = std::variant<Ops...>;
+
+private:
+    struct Completion {
+        std::atomic<bool> ready{false};
+        long result = 0;
+    };
+
+    struct alignas(64) Cell {
+        std::atomic<uint64_t> seq;
+        Request op;
+        Completion* completion;
+    };
+
+    State state;
+    std::vector<Cell> cells;
+    uint64_t mask;
+    alignas(64) std::atomic<uint64_t> tail{0}; // Next slot producers claim
+    alignas(64) uint64_t head = 0;             // Next slot the server reads
+    std::atomic<bool> running{true};
+    std::atomic<bool> sleeping{false};
+    std::mutex sleepMutex;
+    std::condition_variable sleepCV;
+    Calibration calib;
+    std::thread serverThread;
+
+    template <size_t... I>
+    static long dispatch(Request& op, State& s, std::index_sequence<I...>) {
+        long result = 0;
+        // One case per operation type; short-circuits at the matching index
+        (void)((op.index() == I ? (result = std::get<I>(op)(s), true) : false) || ...);
+        return result;
+    }
+
+    bool hasRequest() const {
+        const Cell& cell = cells[head & mask];
+        return cell.seq.load(std::memory_order_acquire) == head + 1;
+    }
+
+    void serve() {
+        for (;;) {
+            SpinWait idle(calib.spinBeforePark, calib);
+            while (!hasRequest() && idle.spin()) {
+            }
+            if (!hasRequest()) {
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                sleeping.store(true, std::memory_order_seq_cst);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                sleepCV.wait(lock, [this] { return hasRequest() || !running; });
+                sleeping.store(false, std::memory_order_relaxed);
+            }
+            if (!hasRequest()) return; // Stopped and drained
+
+            // Drain everything that is ready
+            while (hasRequest()) {
+                Cell& cell = cells[head & mask];
+                long result = apply(cell.op, state);
+                Completion* completion = cell.completion;
+                cell.seq.store(head + mask + 1, std::memory_order_release);
+                head++;
+                completion->result = result;
+                completion->ready.store(true, std::memory_order_release);
+            }
+        }
+    }
+
+    void enqueue(Request&& op, Completion* completion) {
+        uint64_t pos = tail.load(std::memory_order_relaxed);
+        SpinWait full(calib.spinBeforeYield, calib);
+        for (;;) {
+            Cell& cell = cells[pos & mask];
+            uint64_t seq = cell.seq.load(std::memory_order_acquire);
+            int64_t diff = (int64_t)seq - (int64_t)pos;
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.op = std::move(op);
+                    cell.completion = completion;
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    break;
+                }
+            } else if (diff < 0) {
+                full.once(); // Ring is full: wait for the server
+                pos = tail.load(std::memory_order_relaxed);
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+        // Pairs with the fence in serve(): either we see it sleeping, or it
+        // sees our request before it blocks
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            sleepCV.notify_one();
+        }
+    }
+
+public:
+    // capacity is rounded up to a power of two.
+    explicit DelegationServer(size_t capacity = 1024, const Calibration& c = hostCalibration())
+        : calib(c) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        cells = std::vector<Cell>(size);
+        for (size_t i = 0; i < size; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+        mask = size - 1;
+        serverThread = std::thread(&DelegationServer::serve, this);
+    }
+
+    ~DelegationServer() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            running = false;
+        }
+        sleepCV.notify_one();
+        serverThread.join();
+    }
+
+    DelegationServer(const DelegationServer&) = delete;
+    DelegationServer& operator=(const DelegationServer&) = delete;
+
+    // Runs op on the server and waits for its result.
+    template <typename Op>
+    long call(Op op) {
+        Completion completion;
+        enqueue(Request(std::in_place_type<Op>, std::move(op)), &completion);
+        SpinWait wait(calib.spinBeforeYield, calib);
+        while (!completion.ready.load(std::memory_order_acquire)) {
+            wait.once();
+        }
+        return completion.result;
+    }
+
+    // The server's dispatch: runs one request against s.
+    static long apply(Request& op, State& s) {
+        return dispatch(op, s, std::index_sequence_for<Ops...>());
+    }
+
+    // Only safe once no client is calling any more.
+    const State& unsafeState() const { return state; }
+};
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+
+#include "DelegationLock.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Test parameters
+const int OPERATIONS_PER_THREAD = 10000;
+const int MAX_THREADS = 8;
+const int BATCH_SIZES[] = {1, 4, 16, 64, 256};
+atomic<int> sharedCounter(0);
+
+// Same critical section as Delegation_ds, submitted through a batcher.
+// The client waits for each batch it fills, like workerTask waits per call.
+void batchWorkerTask(DelegationLock& lock, int batchSize, int workload) {
+    DelegationBatcher batcher(lock, batchSize);
+    for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+        auto fut = batcher.add([workload] {
+            // Critical section
+            sharedCounter++;
+
+            // Simulate some workload
+            volatile int dummy = 0;
+            for (int j = 0; j < workload; ++j) {
+                dummy += j;
+            }
+        });
+        if (batcher.pending() == 0) {
+            fut.wait();
+        }
+    }
+    batcher.flush().wait();
+}
+
+bool testCorrectness(int threadCount, int batchSize) {
+    DelegationLock lock;
+    sharedCounter = 0;
+
+    vector<thread> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back(batchWorkerTask, ref(lock), batchSize, 10);
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    int expected = threadCount * OPERATIONS_PER_THREAD;
+    if (sharedCounter != expected) {
+        cout << "Error: Expected " << expected << ", got " << sharedCounter << endl;
+        return false;
+    }
+    cout << "Correctness test passed with " << threadCount
+         << " threads (batch size: " << batchSize << ")" << endl;
+    return true;
+}
+
+void testPerformance(int threadCount, int batchSize, int workload) {
+    DelegationLock lock;
+    sharedCounter = 0;
+
+    auto start = high_resolution_clock::now();
+
+    vector<thread> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back(batchWorkerTask, ref(lock), batchSize, workload);
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    auto end = high_resolution_clock::now();
+    auto duration = max<long>(duration_cast<milliseconds>(end - start).count(), 1);
+
+    cout << "Threads: " << threadCount
+         << ", Batch: " << batchSize
+         << ", Workload: " << workload
+         << ", Time: " << duration << " ms"
+         << ", Throughput: " << (threadCount * OPERATIONS_PER_THREAD * 1000.0 / duration) << " ops/sec" << endl;
+}
+
+int main() {
+    // Test correctness with different configurations
+    cout << "Correctness testing:\n";
+    bool ok = true;
+    for (int batchSize : {1, 16}) {
+        for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+            ok = testCorrectness(threads, batchSize) && ok;
+        }
+    }
+
+    // Throughput as a function of batch size
+    cout << "\nPerformance testing:\n";
+    for (int workload : {0, 100}) {
+        for (int threads : {1, MAX_THREADS}) {
+            for (int batchSize : BATCH_SIZES) {
+                testPerformance(threads, batchSize, workload);
+            }
+            cout << endl;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <future>
+
+#include "DelegationLock.h"
+#include "DelegationChannels.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Clients keep a few requests in flight against one server for a fixed time,
+// through DelegationLock's shared queue or through one SPSC channel each.
+// Reports throughput and how evenly the server split itself between clients
+// (slowest client's ops over fastest client's).
+
+// Test parameters
+const int MIN_CLIENTS = 2;
+const int MAX_CLIENTS = 64;
+const int WINDOW = 4;          // Requests in flight per client
+const size_t RING_CAPACITY = 16;
+const size_t QUOTA = 2;
+const milliseconds RUN_LENGTH(200);
+
+struct RunResult {
+    long ops = 0;
+    long minOps = 0;
+    long maxOps = 0;
+};
+
+// submit(client, work) queues work for client and returns its future
+template <typename Connect, typename Submit>
+RunResult runClients(int clientCount, long& counter, Connect connect, Submit submit) {
+    atomic<bool> stop{false};
+    vector<long> ops(clientCount, 0);
+    vector<thread> threads;
+    for (int c = 0; c < clientCount; ++c) {
+        threads.emplace_back([&, c] {
+            auto client = connect();
+            deque<future<void>> window;
+            while (!stop.load(memory_order_relaxed)) {
+                if (window.size() == (size_t)WINDOW) {
+                    window.front().wait();
+                    window.pop_front();
+                    ops[c]++;
+                }
+                window.push_back(submit(client, [&counter] { counter++; }));
+            }
+            for (auto& f : window) {
+                f.wait();
+                ops[c]++;
+            }
+        });
+    }
+    this_thread::sleep_for(RUN_LENGTH);
+    stop = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    RunResult r;
+    r.minOps = *min_element(ops.begin(), ops.end());
+    r.maxOps = *max_element(ops.begin(), ops.end());
+    for (long n : ops) r.ops += n;
+    return r;
+}
+
+bool report(const char* engine, int clients, const RunResult& r, long counter) {
+    cout << "Engine: " << engine << ", Clients: " << clients << fixed << setprecision(2)
+         << ", Throughput: " << r.ops * 1000 / RUN_LENGTH.count() << " ops/sec"
+         << ", Fairness (min/max): " << (r.maxOps ? double(r.minOps) / r.maxOps : 0) << endl;
+    if (counter != r.ops) {
+        cout << "Error: " << engine << " with " << clients << " clients: expected "
+             << r.ops << " updates, got " << counter << endl;
+        return false;
+    }
+    return true;
+}
+
+bool testClients(int clients) {
+    long sharedCounter = 0;
+    RunResult shared;
+    {
+        DelegationLock lock;
+        shared = runClients(clients, sharedCounter, [&] { return &lock; },
+                            [](DelegationLock* l, function<void()> work) {
+                                return l->async(move(work));
+                            });
+    }
+
+    long channelCounter = 0;
+    RunResult channels;
+    {
+        DelegationChannels server(RING_CAPACITY, QUOTA);
+        channels = runClients(clients, channelCounter, [&] { return server.connect(); },
+                              [](DelegationChannels::Channel* ch, function<void()> work) {
+                                  return ch->async(move(work));
+                              });
+    }
+
+    bool ok = report("shared queue", clients, shared, sharedCounter);
+    return report("SPSC channels", clients, channels, channelCounter) && ok;
+}
+
+int main() {
+    bool ok = true;
+    for (int clients = MIN_CLIENTS; clients <= MAX_CLIENTS; clients *= 2) {
+        ok = testClients(clients) && ok;
+    }
+
+    if (ok) {
+        cout << "Correctness test passed with up to " << MAX_CLIENTS << " clients" << endl;
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,247 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include "CombiningDelegationLock.h"
+#include "DelegationLock.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace combining;
+
+// Typed-operation delegation (CombiningDelegationLock) against DelegationLock
+// on a counter, a stack and a queue: checks that every batch gives the
+// results of running it in submission order, then reports throughput with
+// and without commuting operations.
+
+// Test parameters
+const int OPERATIONS_PER_THREAD = 10000;
+const int MAX_THREADS = 8;
+
+// Values pushed/enqueued by thread t are t * OPERATIONS_PER_THREAD + i
+long valueFor(int id, int i) {
+    return (long)id * OPERATIONS_PER_THREAD + i;
+}
+
+// --- Correctness ---
+
+bool testCounter(int threadCount, bool commutes) {
+    CombiningDelegationLock<CounterObject> lock;
+    long total = (long)threadCount * OPERATIONS_PER_THREAD;
+    vector<atomic<int>> seen(total);
+
+    vector<thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+                seen[lock.submit(ADD, 1, commutes)]++;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    // Every fetch-and-add result must be handed out exactly once
+    bool ok = lock.state().value == total;
+    for (long i = 0; i < total && ok; ++i) {
+        ok = seen[i] == 1;
+    }
+    return ok;
+}
+
+// Each thread alternates insert(v) and remove; afterwards every inserted value
+// must have been removed exactly once or still be in the container.
+template <typename Object>
+bool testPairs(int threadCount, OpType insert, OpType remove, bool commutes,
+               const vector<long>& (*leftovers)(const Object&, vector<long>&)) {
+    CombiningDelegationLock<Object> lock;
+    vector<vector<long>> removed(threadCount);
+    bool fifo = insert == ENQUEUE;
+    atomic<bool> orderOk(true);
+
+    vector<thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t] {
+            vector<long> lastFrom(threadCount, -1);
+            for (int i = 0; i < OPERATIONS_PER_THREAD / 2; ++i) {
+                lock.submit(insert, valueFor(t, i), commutes);
+                bool ok = false;
+                long v = lock.submit(remove, 0, commutes, &ok);
+                if (!ok) continue;
+                removed[t].push_back(v);
+                // FIFO: values from one producer come out in order
+                int producer = v / OPERATIONS_PER_THREAD;
+                if (fifo && !commutes && v < lastFrom[producer]) orderOk = false;
+                lastFrom[producer] = v;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    vector<long> all;
+    vector<long> rest;
+    for (auto& r : removed) all.insert(all.end(), r.begin(), r.end());
+    const vector<long>& left = leftovers(lock.state(), rest);
+    all.insert(all.end(), left.begin(), left.end());
+    sort(all.begin(), all.end());
+
+    vector<long> expected;
+    for (int t = 0; t < threadCount; ++t) {
+        for (int i = 0; i < OPERATIONS_PER_THREAD / 2; ++i) expected.push_back(valueFor(t, i));
+    }
+    return all == expected && orderOk;
+}
+
+const vector<long>& stackLeftovers(const StackObject& s, vector<long>&) {
+    return s.items;
+}
+
+const vector<long>& queueLeftovers(const QueueObject& q, vector<long>& out) {
+    out.assign(q.items.begin(), q.items.end());
+    return out;
+}
+
+bool testCorrectness(int threadCount) {
+    bool ok = true;
+    for (bool commutes : {false, true}) {
+        bool counter = testCounter(threadCount, commutes);
+        bool stack = testPairs<StackObject>(threadCount, PUSH, POP, commutes, stackLeftovers);
+        bool queue = testPairs<QueueObject>(threadCount, ENQUEUE, DEQUEUE, commutes, queueLeftovers);
+        if (counter && stack && queue) {
+            cout << "Correctness test passed with " << threadCount << " threads"
+                 << (commutes ? " (commuting)" : "") << endl;
+        } else {
+            cout << "Error: " << (counter ? "" : "counter ") << (stack ? "" : "stack ")
+                 << (queue ? "" : "queue ") << "failed with " << threadCount << " threads"
+                 << (commutes ? " (commuting)" : "") << endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// --- Performance ---
+
+template <typename Body>
+long timeThreads(int threadCount, Body body) {
+    auto start = high_resolution_clock::now();
+    vector<thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back(body, t);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto end = high_resolution_clock::now();
+    return max<long>(duration_cast<milliseconds>(end - start).count(), 1);
+}
+
+void report(const char* workload, const char* engine, int threadCount, long ms,
+            const CombineStats* stats = nullptr) {
+    cout << "Workload: " << workload << ", Engine: " << engine << ", Threads: " << threadCount
+         << ", Time: " << ms << " ms"
+         << ", Throughput: " << (threadCount * OPERATIONS_PER_THREAD * 1000.0 / ms) << " ops/sec";
+    if (stats && stats->batches) {
+        cout << ", Ops/batch: " << (double)stats->ops / stats->batches
+             << ", Merged: " << stats->merged
+             << ", Eliminated pairs: " << stats->eliminated;
+    }
+    cout << endl;
+}
+
+void testPerformance(int threadCount) {
+    // Counter
+    {
+        DelegationLock lock;
+        long counter = 0;
+        long ms = timeThreads(threadCount, [&](int) {
+            for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+                lock.async([&counter] { counter++; }).wait();
+            }
+        });
+        report("counter", "DelegationLock", threadCount, ms);
+    }
+    for (bool commutes : {false, true}) {
+        CombiningDelegationLock<CounterObject> lock;
+        long ms = timeThreads(threadCount, [&](int) {
+            for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+                lock.submit(ADD, 1, commutes);
+            }
+        });
+        report("counter", commutes ? "combining+commute" : "combining", threadCount, ms,
+               &lock.combineStats());
+    }
+
+    // Stack
+    {
+        DelegationLock lock;
+        vector<long> stack;
+        long ms = timeThreads(threadCount, [&](int t) {
+            for (int i = 0; i < OPERATIONS_PER_THREAD / 2; ++i) {
+                long v = valueFor(t, i);
+                lock.async([&stack, v] { stack.push_back(v); }).wait();
+                lock.async([&stack] { if (!stack.empty()) stack.pop_back(); }).wait();
+            }
+        });
+        report("stack", "DelegationLock", threadCount, ms);
+    }
+    for (bool commutes : {false, true}) {
+        CombiningDelegationLock<StackObject> lock;
+        long ms = timeThreads(threadCount, [&](int t) {
+            for (int i = 0; i < OPERATIONS_PER_THREAD / 2; ++i) {
+                lock.submit(PUSH, valueFor(t, i), commutes);
+                lock.submit(POP, 0, commutes);
+            }
+        });
+        report("stack", commutes ? "combining+commute" : "combining", threadCount, ms,
+               &lock.combineStats());
+    }
+
+    // Queue
+    {
+        DelegationLock lock;
+        deque<long> queue;
+        long ms = timeThreads(threadCount, [&](int t) {
+            for (int i = 0; i < OPERATIONS_PER_THREAD / 2; ++i) {
+                long v = valueFor(t, i);
+                lock.async([&queue, v] { queue.push_back(v); }).wait();
+                lock.async([&queue] { if (!queue.empty()) queue.pop_front(); }).wait();
+            }
+        });
+        report("queue", "DelegationLock", threadCount, ms);
+    }
+    for (bool commutes : {false, true}) {
+        CombiningDelegationLock<QueueObject> lock;
+        long ms = timeThreads(threadCount, [&](int t) {
+            for (int i = 0; i < OPERATIONS_PER_THREAD / 2; ++i) {
+                lock.submit(ENQUEUE, valueFor(t, i), commutes);
+                lock.submit(DEQUEUE, 0, commutes);
+            }
+        });
+        report("queue", commutes ? "combining+commute" : "combining", threadCount, ms,
+               &lock.combineStats());
+    }
+}
+
+int main() {
+    cout << "Correctness testing:\n";
+    bool ok = true;
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+        ok = testCorrectness(threads) && ok;
+    }
+
+    cout << "\nPerformance testing:\n";
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+        testPerformance(threads);
+        cout << endl;
+    }
+
+    return ok ? 0 : 1;
+}
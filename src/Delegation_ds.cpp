@@ -1,80 +1,25 @@
 #include <iostream>
 #include <thread>
 #include <vector>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
 #include <atomic>
 #include <chrono>
-#include <functional>
-#include <future>
+#include <cstring>
+
+#include "DelegationLock.h"
+#include "Placement.h"
 
 using namespace std;
 using namespace std::chrono;
 
-class DelegationLock {
-private:
-    struct Task {
-        function<void()> work;
-        promise<void> completion;
-    };
-
-    queue<Task> taskQueue;
-    mutex queueMutex;
-    condition_variable queueCV;
-    thread workerThread;
-    atomic<bool> running;
-
-    void worker() {
-        while (running) {
-            unique_lock<mutex> lock(queueMutex);
-            queueCV.wait(lock, [this] { return !taskQueue.empty() || !running; });
-
-            if (!running) break;
-
-            Task task = std::move(taskQueue.front());
-            taskQueue.pop();
-            lock.unlock();
-
-            // Execute the critical section work
-            task.work();
-            
-            // Notify completion
-            task.completion.set_value();
-        }
-    }
-
-public:
-    DelegationLock() : running(true) {
-        workerThread = thread(&DelegationLock::worker, this);
-    }
-
-    ~DelegationLock() {
-        running = false;
-        queueCV.notify_one();
-        if (workerThread.joinable()) {
-            workerThread.join();
-        }
-    }
-
-    future<void> async(function<void()> work) {
-        Task task;
-        task.work = std::move(work);
-        auto fut = task.completion.get_future();
-
-        lock_guard<mutex> lock(queueMutex);
-        taskQueue.push(std::move(task));
-        queueCV.notify_one();
-
-        return fut;
-    }
-};
-
 // Test parameters
 const int OPERATIONS_PER_THREAD = 10000;
 const int MAX_THREADS = 8;
 atomic<int> sharedCounter(0);
 
+// Set by --matrix: place the server and clients from a CoreLatency matrix
+LatencyMatrix placementMatrix;
+bool usePlacement = false;
+
 void workerTask(int id, DelegationLock& lock, int workload) {
     for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
         auto fut = lock.async([id, workload] {
@@ -114,14 +59,23 @@ void testCorrectness(int threadCount, int workload) {
 }
 
 void testPerformance(int threadCount, int workload) {
-    DelegationLock lock;
+    Placement placement;
+    if (usePlacement) {
+        placement = planPlacement(placementMatrix, threadCount, true);
+    }
+    DelegationLock lock(placement.serverCpu);
     sharedCounter = 0;
     
     auto start = high_resolution_clock::now();
     
     vector<thread> threads;
     for (int i = 0; i < threadCount; ++i) {
-        threads.emplace_back(workerTask, i, ref(lock), workload);
+        threads.emplace_back([&lock, &placement, i, workload] {
+            if (!placement.threadCpus.empty()) {
+                pinCurrentThread(placement.threadCpus[i]);
+            }
+            workerTask(i, lock, workload);
+        });
     }
     
     for (auto& t : threads) {
@@ -137,7 +91,19 @@ void testPerformance(int threadCount, int workload) {
          << ", Throughput: " << (threadCount * OPERATIONS_PER_THREAD * 1000.0 / duration) << " ops/sec" << endl;
 }
 
-int main() {
+int main(int argc, char** argv) {
+    if (argc == 3 && !strcmp(argv[1], "--matrix")) {
+        usePlacement = loadLatencyMatrix(argv[2], "delegation", placementMatrix) ||
+                       loadLatencyMatrix(argv[2], "pingpong", placementMatrix);
+        if (!usePlacement) {
+            cerr << "Error: no usable latency matrix in " << argv[2] << endl;
+            return 1;
+        }
+    } else if (argc != 1) {
+        cerr << "Usage: " << argv[0] << " [--matrix file.csv]" << endl;
+        return 1;
+    }
+
     // Test correctness with different configurations
     cout << "Correctness testing:\n";
     for (int workload : {0, 10, 100}) {
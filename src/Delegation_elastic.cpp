@@ -0,0 +1,143 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <algorithm>
+#include <sys/resource.h>
+
+#include "DelegationPool.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Alternates bursts (every client in a closed loop) with quiet phases (one
+// client at a low rate) against a fixed pool sized for the bursts and an
+// elastic pool, and reports CPU time, active servers and p99 latency per
+// phase against a latency SLO.
+
+// Test parameters
+const int OBJECTS = 10000;
+const int MAX_SERVERS = 4;
+const int BURST_CLIENTS = 8;
+const int PHASES = 4; // burst, quiet, burst, quiet
+const milliseconds PHASE_LENGTH(200);
+const microseconds QUIET_GAP(200);
+const double SLO_P99_US = 5000;
+
+struct PoolObject {
+    unique_ptr<DelegationPool::Mailbox> mailbox;
+    long value = 0; // Only touched by the mailbox's server
+};
+
+double cpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+struct PhaseResult {
+    long ops = 0;
+    double p99Us = 0;
+    double cpu = 0;
+    int serversAtEnd = 0;
+};
+
+PhaseResult runPhase(DelegationPool& pool, vector<unique_ptr<PoolObject>>& objects,
+                     bool burst, long& submitted) {
+    int clients = burst ? BURST_CLIENTS : 1;
+    vector<vector<uint64_t>> latencies(clients);
+    double cpuBefore = cpuSeconds();
+    auto until = steady_clock::now() + PHASE_LENGTH;
+
+    vector<thread> threads;
+    for (int t = 0; t < clients; ++t) {
+        threads.emplace_back([&, t] {
+            mt19937 rng(t + (burst ? 1 : 100));
+            uniform_int_distribution<int> pick(0, OBJECTS - 1);
+            while (steady_clock::now() < until) {
+                PoolObject* obj = objects[pick(rng)].get();
+                uint64_t start = lockstats::nowNs();
+                obj->mailbox->async([obj] { obj->value++; }).wait();
+                latencies[t].push_back(lockstats::nowNs() - start);
+                if (!burst) {
+                    this_thread::sleep_for(QUIET_GAP);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    vector<uint64_t> all;
+    for (auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+    sort(all.begin(), all.end());
+
+    PhaseResult r;
+    r.ops = all.size();
+    r.p99Us = all.empty() ? 0 : all[all.size() * 99 / 100] / 1000.0;
+    r.cpu = cpuSeconds() - cpuBefore;
+    r.serversAtEnd = pool.serverCount();
+    submitted += r.ops;
+    return r;
+}
+
+bool runPool(const char* name, DelegationPool& pool) {
+    vector<unique_ptr<PoolObject>> objects;
+    for (int k = 0; k < OBJECTS; ++k) {
+        objects.emplace_back(new PoolObject());
+        objects.back()->mailbox = pool.createMailbox();
+    }
+
+    long submitted = 0;
+    double totalCpu = 0;
+    bool sloMet = true;
+    for (int phase = 0; phase < PHASES; ++phase) {
+        bool burst = phase % 2 == 0;
+        PhaseResult r = runPhase(pool, objects, burst, submitted);
+        totalCpu += r.cpu;
+        sloMet = sloMet && r.p99Us <= SLO_P99_US;
+        cout << "Pool: " << name << ", Phase: " << (burst ? "burst" : "quiet")
+             << ", Ops: " << r.ops << fixed << setprecision(1)
+             << ", p99: " << r.p99Us << " us"
+             << ", CPU: " << r.cpu * 1000 << " ms"
+             << ", Servers: " << r.serversAtEnd << endl;
+    }
+    cout << "Pool: " << name << ", Total CPU: " << totalCpu * 1000 << " ms"
+         << ", Scale events: " << pool.scaleEventCount()
+         << ", p99 SLO (" << SLO_P99_US << " us): " << (sloMet ? "met" : "missed") << endl;
+
+    long total = 0;
+    for (auto& obj : objects) total += obj->value;
+    if (total != submitted) {
+        cout << "Error: Expected " << submitted << " updates, got " << total << endl;
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    bool ok;
+    {
+        DelegationPool fixedPool(MAX_SERVERS);
+        ok = runPool("fixed", fixedPool);
+    }
+    {
+        ElasticConfig config;
+        config.minServers = 1;
+        config.maxServers = MAX_SERVERS;
+        DelegationPool elasticPool(config);
+        ok = runPool("elastic", elasticPool) && ok;
+    }
+
+    if (ok) {
+        cout << "Correctness test passed: no updates lost across scaling" << endl;
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,204 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "DelegationLock.h"
+#include "DelegationEventLoop.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// A DelegationEventLoop serves in-process requests, a pipe and timers
+// against one piece of state; every callback checks that it ran alone on
+// the server. Then request throughput against DelegationLock, with the
+// number of eventfd signals the clients needed.
+
+// Test parameters
+const int CLIENT_THREADS = 4;
+const int WINDOW = 8;                // Requests in flight per client
+const int OPERATIONS_PER_THREAD = 20000;
+const int PIPE_MESSAGES = 2000;
+const milliseconds TICK(1);
+const milliseconds RUN_LENGTH(200);
+const int CLIENT_COUNTS[] = {1, 4, 16};
+
+// Owned by the server; no field needs to be atomic
+struct Shard {
+    long requests = 0;
+    long pipeBytes = 0;
+    long ticks = 0;
+    int oneShots = 0;
+    thread::id owner;
+    int strangers = 0; // Callbacks that ran off the server thread
+
+    void enter() {
+        if (owner == thread::id()) owner = this_thread::get_id();
+        strangers += owner != this_thread::get_id();
+    }
+};
+
+bool testEventLoop() {
+    Shard shard;
+    atomic<int> inside{0};
+    atomic<int> overlaps{0};
+    auto exclusive = [&](auto f) {
+        if (inside.fetch_add(1) != 0) overlaps++;
+        shard.enter();
+        f();
+        inside.fetch_sub(1);
+    };
+
+    int fds[2];
+    if (pipe2(fds, O_NONBLOCK) != 0) {
+        cout << "Error: cannot create a pipe" << endl;
+        return false;
+    }
+
+    long ticksAfterCancel = 0;
+    auto start = steady_clock::now();
+    {
+        DelegationEventLoop loop;
+        loop.watch(fds[0], EPOLLIN, [&](uint32_t) {
+            exclusive([&] {
+                char buffer[256];
+                ssize_t n;
+                while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) shard.pipeBytes += n;
+            });
+        }).get();
+        int ticker = loop.addTimer(TICK, TICK, [&](uint64_t expirations) {
+            exclusive([&] { shard.ticks += expirations; });
+        }).get();
+        loop.addTimer(milliseconds(5), nanoseconds(0), [&](uint64_t) {
+            exclusive([&] { shard.oneShots++; });
+        }).get();
+
+        vector<thread> threads;
+        for (int t = 0; t < CLIENT_THREADS; ++t) {
+            threads.emplace_back([&] {
+                deque<future<void>> window;
+                for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+                    if (window.size() == (size_t)WINDOW) {
+                        window.front().wait();
+                        window.pop_front();
+                    }
+                    window.push_back(loop.async([&] { exclusive([&] { shard.requests++; }); }));
+                }
+                for (auto& f : window) f.wait();
+            });
+        }
+        threads.emplace_back([&] {
+            for (int i = 0; i < PIPE_MESSAGES; ++i) {
+                char byte = 'x';
+                while (write(fds[1], &byte, 1) != 1) this_thread::yield();
+                if (i % 64 == 0) this_thread::sleep_for(microseconds(100));
+            }
+        });
+        for (auto& t : threads) {
+            t.join();
+        }
+        this_thread::sleep_until(start + RUN_LENGTH);
+
+        loop.cancelTimer(ticker).get();
+        loop.async([&] { ticksAfterCancel = shard.ticks; }).get();
+        this_thread::sleep_for(5 * TICK);
+        loop.async([&] { ticksAfterCancel = shard.ticks - ticksAfterCancel; }).get();
+        loop.unwatch(fds[0]).get();
+    }
+    close(fds[0]);
+    close(fds[1]);
+
+    long elapsedTicks = duration_cast<milliseconds>(steady_clock::now() - start) / TICK;
+    long expected = (long)CLIENT_THREADS * OPERATIONS_PER_THREAD;
+    cout << "Event loop: " << shard.requests << " requests, " << shard.pipeBytes << " pipe bytes, "
+         << shard.ticks << " ticks in about " << elapsedTicks << " tick periods" << endl;
+
+    bool ok = true;
+    if (shard.requests != expected || shard.pipeBytes != PIPE_MESSAGES) {
+        cout << "Error: expected " << expected << " requests and " << PIPE_MESSAGES << " pipe bytes" << endl;
+        ok = false;
+    }
+    if (shard.ticks < elapsedTicks / 2 || shard.ticks > elapsedTicks + 1 || shard.oneShots != 1) {
+        cout << "Error: timers fired " << shard.ticks << " periodic and " << shard.oneShots
+             << " one-shot times" << endl;
+        ok = false;
+    }
+    if (ticksAfterCancel != 0) {
+        cout << "Error: a cancelled timer fired " << ticksAfterCancel << " times" << endl;
+        ok = false;
+    }
+    if (overlaps != 0 || shard.strangers != 0) {
+        cout << "Error: " << overlaps << " overlapping callbacks, " << shard.strangers
+             << " off the server thread" << endl;
+        ok = false;
+    }
+    return ok;
+}
+
+template <typename Submit>
+long runClients(int clientCount, Submit submit) {
+    atomic<bool> stop{false};
+    atomic<long> ops{0};
+    vector<thread> threads;
+    for (int c = 0; c < clientCount; ++c) {
+        threads.emplace_back([&] {
+            deque<future<void>> window;
+            long done = 0;
+            while (!stop.load(memory_order_relaxed)) {
+                if (window.size() == (size_t)WINDOW) {
+                    window.front().wait();
+                    window.pop_front();
+                    done++;
+                }
+                window.push_back(submit());
+            }
+            for (auto& f : window) f.wait();
+            ops += done + window.size();
+        });
+    }
+    this_thread::sleep_for(RUN_LENGTH);
+    stop = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    return ops;
+}
+
+void benchmark(int clientCount) {
+    long counter = 0;
+    long lockOps;
+    {
+        DelegationLock lock;
+        lockOps = runClients(clientCount, [&] { return lock.async([&counter] { counter++; }); });
+    }
+    long loopOps, signals, sleeps;
+    {
+        DelegationEventLoop loop;
+        loopOps = runClients(clientCount, [&] { return loop.async([&counter] { counter++; }); });
+        signals = loop.signalCount();
+        sleeps = loop.sleepCount();
+    }
+    cout << "Clients: " << clientCount
+         << ", DelegationLock: " << lockOps * 1000 / RUN_LENGTH.count() << " ops/sec"
+         << ", DelegationEventLoop: " << loopOps * 1000 / RUN_LENGTH.count() << " ops/sec"
+         << ", Signals: " << signals << " (" << fixed << setprecision(3)
+         << double(signals) / max(loopOps, 1L) << " per request, " << sleeps << " sleeps)" << endl;
+}
+
+int main() {
+    bool ok = testEventLoop();
+    for (int clients : CLIENT_COUNTS) {
+        benchmark(clients);
+    }
+    if (ok) {
+        cout << "Correctness test passed: requests, descriptors and timers all ran alone on the server" << endl;
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,162 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <string>
+
+#include "DelegationLock.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Open-loop producers offer a few times what the server can run. With an
+// unbounded queue, queueing delay grows for as long as the overload lasts;
+// with a capacity the delay stays near capacity x service time, and the
+// overflow policy decides who pays: blocked producers, rejected requests or
+// shed bulk requests.
+
+// Test parameters
+const int PRODUCERS = 4;
+const int BURST = 100;                 // Requests per producer per tick
+const milliseconds TICK(1);
+const int HIGH_EVERY = 64;             // One request in HIGH_EVERY is High, the rest Bulk
+const int WORK_ITERATIONS = 2000;      // Critical section length
+const size_t CAPACITY = 256;
+const milliseconds RUN_LENGTH(300);
+
+struct Outcome {
+    string mode;
+    long submitted[2] = {0, 0}; // High, Bulk
+    long completed[2] = {0, 0};
+    long rejected = 0;
+    long shed = 0;
+    size_t peakDepth = 0;
+    vector<uint64_t> latencies[2]; // Submit to run, filled by the server
+};
+
+double percentileUs(vector<uint64_t>& v, int p) {
+    if (v.empty()) return 0;
+    sort(v.begin(), v.end());
+    return v[min(v.size() - 1, v.size() * p / 100)] / 1000.0;
+}
+
+Outcome runOverload(const string& mode) {
+    Outcome out;
+    out.mode = mode;
+    DelegationLock lock;
+    if (mode == "block") {
+        lock.setCapacity(CAPACITY, OverflowPolicy::Block);
+    } else if (mode == "reject") {
+        lock.setCapacity(CAPACITY, OverflowPolicy::Reject);
+    } else if (mode == "shed") {
+        lock.setCapacity(CAPACITY, OverflowPolicy::ShedLowest);
+    }
+
+    long state = 0; // Only touched on the server
+    atomic<bool> stop{false};
+    atomic<long> submitted[2] = {{0}, {0}};
+    atomic<size_t> peakDepth{0};
+
+    vector<thread> producers;
+    for (int t = 0; t < PRODUCERS; ++t) {
+        producers.emplace_back([&, t] {
+            long sent[2] = {0, 0};
+            size_t peak = 0;
+            auto next = steady_clock::now();
+            for (long i = t; !stop.load(memory_order_relaxed); i += PRODUCERS) {
+                if (i / PRODUCERS % BURST == 0) {
+                    // Paced, not closed-loop: blocking makes a producer late
+                    // but does not lower what it offers afterwards
+                    this_thread::sleep_until(next);
+                    next += TICK;
+                }
+                int cls = i % HIGH_EVERY == 0 ? 0 : 1;
+                Priority priority = cls == 0 ? Priority::High : Priority::Bulk;
+                uint64_t submitNs = lockstats::nowNs();
+                auto work = [&out, &state, cls, submitNs] {
+                    for (int k = 0; k < WORK_ITERATIONS; ++k) {
+                        state = state * 31 + k;
+                    }
+                    out.latencies[cls].push_back(lockstats::nowNs() - submitNs);
+                };
+                if (mode == "reject") {
+                    lock.tryAsync(work, priority);
+                } else {
+                    lock.async(work, priority);
+                }
+                sent[cls]++;
+                peak = max(peak, lock.queueDepth());
+            }
+            submitted[0] += sent[0];
+            submitted[1] += sent[1];
+            size_t seen = peakDepth.load();
+            while (peak > seen && !peakDepth.compare_exchange_weak(seen, peak)) {
+            }
+        });
+    }
+
+    this_thread::sleep_for(RUN_LENGTH);
+    stop = true;
+    for (auto& t : producers) {
+        t.join();
+    }
+
+    // Drain: a Bulk request queued last runs after everything admitted
+    lock.setCapacity(0);
+    lock.async([] {}, Priority::Bulk).wait();
+
+    for (int cls = 0; cls < 2; ++cls) {
+        out.submitted[cls] = submitted[cls];
+        out.completed[cls] = out.latencies[cls].size();
+    }
+    out.rejected = lock.rejectedCount();
+    out.shed = lock.shedCount();
+    out.peakDepth = peakDepth;
+    return out;
+}
+
+bool report(Outcome& r) {
+    long submitted = r.submitted[0] + r.submitted[1];
+    long completed = r.completed[0] + r.completed[1];
+    cout << "Mode: " << r.mode << ", Submitted: " << submitted
+         << ", Completed: " << completed << ", Rejected: " << r.rejected
+         << ", Shed: " << r.shed << ", Peak depth: " << r.peakDepth << fixed << setprecision(1)
+         << ", High p99: " << percentileUs(r.latencies[0], 99) << " us"
+         << ", Bulk p99: " << percentileUs(r.latencies[1], 99) << " us"
+         << ", Max: " << max(percentileUs(r.latencies[0], 100), percentileUs(r.latencies[1], 100))
+         << " us" << endl;
+
+    bool ok = true;
+    if (completed != submitted - r.rejected - r.shed) {
+        cout << "Error: " << r.mode << ": " << submitted - r.rejected - r.shed
+             << " requests admitted, " << completed << " ran" << endl;
+        ok = false;
+    }
+    if (r.mode != "unbounded" && r.peakDepth > CAPACITY) {
+        cout << "Error: " << r.mode << ": queue reached " << r.peakDepth
+             << ", capacity " << CAPACITY << endl;
+        ok = false;
+    }
+    if (r.mode == "shed" && r.completed[0] != r.submitted[0]) {
+        cout << "Error: shed: " << r.submitted[0] - r.completed[0] << " High requests lost" << endl;
+        ok = false;
+    }
+    return ok;
+}
+
+int main() {
+    bool ok = true;
+    for (const string mode : {"unbounded", "block", "reject", "shed"}) {
+        Outcome r = runOverload(mode);
+        ok = report(r) && ok;
+    }
+
+    if (ok) {
+        cout << "Correctness test passed: every admitted request ran, none beyond capacity" << endl;
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,157 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <future>
+
+#include "DelegationLock.h"
+#include "ParallelDelegation.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Requests read one key and update another. With probability conflictRate a
+// request writes the hot key 0, otherwise a random key out of KEYS, so the
+// conflict rate sets how much of a batch must run in order. Compares the
+// serial DelegationLock server with the parallel executor.
+
+// Test parameters
+const int KEYS = 4096;
+const int CLIENT_THREADS = 4;
+const int WINDOW = 16;                  // Requests in flight per client
+const int OPERATIONS_PER_THREAD = 5000;
+const int WORK_ITERATIONS = 500;        // Cost of one request
+const int WORKER_COUNTS[] = {0, 1, 3};
+const double CONFLICT_RATES[] = {0.0, 0.1, 0.5, 1.0};
+
+struct Op {
+    int readKey;
+    int writeKey;
+    long salt;
+};
+
+// Order-dependent, so a reordered conflict changes the result
+void apply(vector<long>& values, const Op& op) {
+    long x = values[op.readKey] + op.salt;
+    for (int i = 0; i < WORK_ITERATIONS; ++i) {
+        x = x * 6364136223846793005L + 1442695040888963407L;
+    }
+    values[op.writeKey] = values[op.writeKey] * 31 + (x >> 33);
+}
+
+KeySet keysOf(const Op& op) {
+    return KeySet{{(uint64_t)op.readKey}, {(uint64_t)op.writeKey}};
+}
+
+vector<Op> makeOps(int id, double conflictRate) {
+    mt19937 rng(id + 1);
+    uniform_int_distribution<int> key(1, KEYS - 1);
+    bernoulli_distribution hot(conflictRate);
+    vector<Op> ops(OPERATIONS_PER_THREAD);
+    for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+        ops[i] = {key(rng), hot(rng) ? 0 : key(rng), (long)id << 32 | i};
+    }
+    return ops;
+}
+
+// Keeps WINDOW requests in flight; submit(op) returns its future
+template <typename Submit>
+void runWindowed(const vector<Op>& ops, Submit submit) {
+    deque<future<void>> window;
+    for (const Op& op : ops) {
+        if (window.size() == (size_t)WINDOW) {
+            window.front().wait();
+            window.pop_front();
+        }
+        window.push_back(submit(op));
+    }
+    for (auto& f : window) {
+        f.wait();
+    }
+}
+
+// One client: the executor must match a serial run of the same sequence
+bool testSerialEquivalence(int workers) {
+    vector<Op> ops = makeOps(0, 0.3);
+    vector<long> expected(KEYS, 1);
+    for (const Op& op : ops) {
+        apply(expected, op);
+    }
+
+    vector<long> values(KEYS, 1);
+    {
+        ParallelDelegation executor(workers);
+        runWindowed(ops, [&](const Op& op) {
+            return executor.async(keysOf(op), [&values, op] { apply(values, op); });
+        });
+    }
+    if (values != expected) {
+        cout << "Error: " << workers << " workers diverged from serial execution" << endl;
+        return false;
+    }
+    cout << "Correctness test passed: serial-equivalent with " << workers << " workers" << endl;
+    return true;
+}
+
+template <typename Submit>
+long runClients(double conflictRate, Submit submit) {
+    vector<vector<Op>> ops;
+    for (int id = 0; id < CLIENT_THREADS; ++id) {
+        ops.push_back(makeOps(id, conflictRate));
+    }
+    auto start = high_resolution_clock::now();
+    vector<thread> threads;
+    for (int id = 0; id < CLIENT_THREADS; ++id) {
+        threads.emplace_back([&, id] { runWindowed(ops[id], submit); });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    return duration_cast<nanoseconds>(high_resolution_clock::now() - start).count();
+}
+
+void report(const string& engine, double conflictRate, long ns) {
+    long total = (long)CLIENT_THREADS * OPERATIONS_PER_THREAD;
+    cout << "Engine: " << engine << ", Conflict rate: " << fixed << setprecision(1) << conflictRate
+         << ", Time: " << ns / 1000000 << " ms"
+         << ", Throughput: " << (long)(total * 1e9 / ns) << " ops/sec" << endl;
+}
+
+void testPerformance(double conflictRate) {
+    {
+        DelegationLock lock;
+        vector<long> values(KEYS, 1);
+        long ns = runClients(conflictRate, [&](const Op& op) {
+            return lock.async([&values, op] { apply(values, op); });
+        });
+        report("DelegationLock", conflictRate, ns);
+    }
+    for (int workers : WORKER_COUNTS) {
+        ParallelDelegation executor(workers);
+        vector<long> values(KEYS, 1);
+        long ns = runClients(conflictRate, [&](const Op& op) {
+            return executor.async(keysOf(op), [&values, op] { apply(values, op); });
+        });
+        report("ParallelDelegation, " + to_string(workers) + " workers", conflictRate, ns);
+    }
+}
+
+int main() {
+    cout << "Correctness testing:\n";
+    bool ok = true;
+    for (int workers : WORKER_COUNTS) {
+        ok = testSerialEquivalence(workers) && ok;
+    }
+
+    cout << "\nPerformance testing:\n";
+    cout << "Hardware threads: " << thread::hardware_concurrency() << endl;
+    for (double conflictRate : CONFLICT_RATES) {
+        testPerformance(conflictRate);
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,188 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <unordered_map>
+
+#include "DelegationLock.h"
+#include "DelegationPipeline.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// A three-step flow, index -> store -> stats, run all on one DelegationLock
+// server or as a three-stage pipeline with one server per piece of state.
+// Reports throughput and the per-stage queue depths seen during the run.
+
+// Test parameters
+const int CLIENT_THREADS = 4;
+const int WINDOW = 32;                 // Requests in flight per client
+const int OPERATIONS_PER_THREAD = 10000;
+const int KEYS = 1 << 14;
+const int STEP_ITERATIONS = 300;       // Cost of each step
+const size_t RING_CAPACITY = 256;
+const size_t STAGE_BATCH = 32;
+
+struct Request {
+    long key = 0;
+    long value = 0;
+    long slot = -1;     // Set by the index
+    long previous = 0;  // Set by the store
+};
+
+long mix(long x) {
+    for (int i = 0; i < STEP_ITERATIONS; ++i) {
+        x = x * 6364136223846793005L + 1442695040888963407L;
+    }
+    return x;
+}
+
+// The three pieces of state; each step only touches its own
+struct Index {
+    unordered_map<long, long> slots;
+    long spin = 0;
+    void step(Request& r) {
+        spin += mix(r.key);
+        auto it = slots.emplace(r.key, (long)slots.size()).first;
+        r.slot = it->second;
+    }
+};
+
+struct Store {
+    vector<long> values = vector<long>(KEYS, 0);
+    long spin = 0;
+    void step(Request& r) {
+        spin += mix(r.value);
+        r.previous = values[r.slot];
+        values[r.slot] += r.value;
+    }
+};
+
+struct Stats {
+    long count = 0;
+    long sum = 0;
+    long spin = 0;
+    void step(Request& r) {
+        spin += mix(r.slot);
+        count++;
+        sum += r.value;
+    }
+};
+
+struct Flow {
+    Index index;
+    Store store;
+    Stats stats;
+};
+
+Request makeRequest(int id, int i) {
+    Request r;
+    r.key = (long)(id * 7919 + i * 104729) % KEYS;
+    r.value = id + 1;
+    return r;
+}
+
+// submit(request) returns a future for the processed request
+template <typename Submit>
+long runClients(Submit submit, atomic<long>& badResults) {
+    auto start = high_resolution_clock::now();
+    vector<thread> threads;
+    for (int id = 0; id < CLIENT_THREADS; ++id) {
+        threads.emplace_back([&, id] {
+            deque<future<Request>> window;
+            auto retire = [&] {
+                Request r = window.front().get();
+                if (r.slot < 0 || r.previous < 0) badResults++;
+                window.pop_front();
+            };
+            for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+                if (window.size() == (size_t)WINDOW) retire();
+                window.push_back(submit(makeRequest(id, i)));
+            }
+            while (!window.empty()) retire();
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    return duration_cast<nanoseconds>(high_resolution_clock::now() - start).count();
+}
+
+void report(const char* engine, long ns) {
+    long total = (long)CLIENT_THREADS * OPERATIONS_PER_THREAD;
+    cout << "Engine: " << engine << ", Time: " << ns / 1000000 << " ms"
+         << ", Throughput: " << (long)(total * 1e9 / ns) << " ops/sec" << endl;
+}
+
+bool sameFlow(const Flow& a, const Flow& b) {
+    return a.index.slots.size() == b.index.slots.size() && a.stats.count == b.stats.count &&
+           a.stats.sum == b.stats.sum && a.store.values.size() == b.store.values.size();
+}
+
+int main() {
+    atomic<long> badResults{0};
+
+    Flow serial;
+    {
+        DelegationLock lock;
+        long ns = runClients([&](Request r) {
+            auto done = make_shared<promise<Request>>();
+            auto fut = done->get_future();
+            lock.async([&serial, r, done]() mutable {
+                serial.index.step(r);
+                serial.store.step(r);
+                serial.stats.step(r);
+                done->set_value(r);
+            });
+            return fut;
+        }, badResults);
+        report("DelegationLock (one server)", ns);
+    }
+
+    Flow staged;
+    vector<size_t> peakDepth(3, 0);
+    {
+        DelegationPipeline<Request> pipeline({
+            {"index", [&staged](Request& r) { staged.index.step(r); }, STAGE_BATCH},
+            {"store", [&staged](Request& r) { staged.store.step(r); }, STAGE_BATCH},
+            {"stats", [&staged](Request& r) { staged.stats.step(r); }, STAGE_BATCH},
+        }, RING_CAPACITY);
+
+        atomic<bool> sampling{true};
+        thread sampler([&] {
+            while (sampling) {
+                for (int s = 0; s < pipeline.stageCount(); ++s) {
+                    peakDepth[s] = max(peakDepth[s], pipeline.stageDepth(s));
+                }
+                this_thread::sleep_for(microseconds(100));
+            }
+        });
+        long ns = runClients([&](Request r) { return pipeline.submit(r); }, badResults);
+        sampling = false;
+        sampler.join();
+        report("DelegationPipeline (3 stages)", ns);
+
+        cout << "Peak queue depth:";
+        for (int s = 0; s < pipeline.stageCount(); ++s) {
+            cout << " " << pipeline.stageName(s) << " " << peakDepth[s];
+        }
+        cout << endl;
+    }
+
+    // Per-key totals do not depend on the order requests arrived in
+    long total = (long)CLIENT_THREADS * OPERATIONS_PER_THREAD;
+    bool ok = badResults == 0 && sameFlow(serial, staged) && staged.stats.count == total;
+    for (auto& [key, slot] : serial.index.slots) {
+        ok = ok && serial.store.values[slot] == staged.store.values[staged.index.slots[key]];
+    }
+    if (!ok) {
+        cout << "Error: pipeline state differs from the single server's" << endl;
+        return 1;
+    }
+    cout << "Correctness test passed with " << CLIENT_THREADS << " client threads" << endl;
+    return 0;
+}
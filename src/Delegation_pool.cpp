@@ -0,0 +1,151 @@
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <string>
+#include <system_error>
+
+#include "DelegationLock.h"
+#include "DelegationPool.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Test parameters
+const int POOL_OBJECTS = 10000;
+const int DEDICATED_OBJECTS = 1000; // A thread each; 10,000 would exhaust most limits
+const int POOL_SERVERS = 4;
+const int CLIENT_THREADS = 8;
+const int OPERATIONS_PER_THREAD = 10000;
+
+// Reads a "Key:   value" line from /proc/self/status
+long procStatus(const string& key) {
+    ifstream in("/proc/self/status");
+    string line;
+    while (getline(in, line)) {
+        if (line.compare(0, key.size() + 1, key + ":") == 0) {
+            return stol(line.substr(key.size() + 1));
+        }
+    }
+    return -1;
+}
+
+struct PoolObject {
+    unique_ptr<DelegationPool::Mailbox> mailbox;
+    long value = 0; // Only touched by the mailbox's server
+};
+
+struct DedicatedObject {
+    DelegationLock lock;
+    long value = 0;
+};
+
+// Clients hit random objects; expected[k] counts what object k should hold
+template <typename Submit>
+long runClients(int objectCount, vector<atomic<int>>& expected, Submit submit) {
+    auto start = high_resolution_clock::now();
+    vector<thread> threads;
+    for (int t = 0; t < CLIENT_THREADS; ++t) {
+        threads.emplace_back([&, t] {
+            mt19937 rng(t + 1);
+            uniform_int_distribution<int> pick(0, objectCount - 1);
+            for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+                int k = pick(rng);
+                expected[k]++;
+                submit(k).wait();
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    return max<long>(duration_cast<milliseconds>(high_resolution_clock::now() - start).count(), 1);
+}
+
+template <typename Objects>
+bool checkObjects(const Objects& objects, const vector<atomic<int>>& expected) {
+    for (size_t k = 0; k < objects.size(); ++k) {
+        if (objects[k]->value != expected[k]) {
+            cout << "Error: object " << k << " expected " << expected[k]
+                 << ", got " << objects[k]->value << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void report(const char* engine, int objects, long baseThreads, long baseRssKb,
+            long threadsAfter, long rssAfterKb, long ms) {
+    long totalOps = (long)CLIENT_THREADS * OPERATIONS_PER_THREAD;
+    cout << "Engine: " << engine << ", Objects: " << objects
+         << ", Server threads: " << threadsAfter - baseThreads
+         << ", Memory: " << (rssAfterKb - baseRssKb) << " KB ("
+         << (rssAfterKb - baseRssKb) * 1024.0 / objects << " B/object)"
+         << ", Time: " << ms << " ms"
+         << ", Throughput: " << totalOps * 1000.0 / ms << " ops/sec" << endl;
+}
+
+bool testPool() {
+    long baseThreads = procStatus("Threads");
+    long baseRss = procStatus("VmRSS");
+
+    DelegationPool pool(POOL_SERVERS);
+    vector<unique_ptr<PoolObject>> objects;
+    for (int k = 0; k < POOL_OBJECTS; ++k) {
+        objects.emplace_back(new PoolObject());
+        objects.back()->mailbox = pool.createMailbox();
+    }
+    long threads = procStatus("Threads");
+    long rss = procStatus("VmRSS");
+
+    vector<atomic<int>> expected(POOL_OBJECTS);
+    long ms = runClients(POOL_OBJECTS, expected, [&](int k) {
+        PoolObject* obj = objects[k].get();
+        return obj->mailbox->async([obj] { obj->value++; });
+    });
+
+    report("DelegationPool", POOL_OBJECTS, baseThreads, baseRss, threads, rss, ms);
+    return checkObjects(objects, expected);
+}
+
+bool testDedicated() {
+    long baseThreads = procStatus("Threads");
+    long baseRss = procStatus("VmRSS");
+
+    vector<unique_ptr<DedicatedObject>> objects;
+    try {
+        for (int k = 0; k < DEDICATED_OBJECTS; ++k) {
+            objects.emplace_back(new DedicatedObject());
+        }
+    } catch (const system_error& e) {
+        cout << "DelegationLock per object: stopped at " << objects.size()
+             << " objects (" << e.what() << ")" << endl;
+        return true;
+    }
+    long threads = procStatus("Threads");
+    long rss = procStatus("VmRSS");
+
+    vector<atomic<int>> expected(DEDICATED_OBJECTS);
+    long ms = runClients(DEDICATED_OBJECTS, expected, [&](int k) {
+        DedicatedObject* obj = objects[k].get();
+        return obj->lock.async([obj] { obj->value++; });
+    });
+
+    report("DelegationLock per object", DEDICATED_OBJECTS, baseThreads, baseRss, threads, rss, ms);
+    return checkObjects(objects, expected);
+}
+
+int main() {
+    bool poolOk = testPool();
+    bool dedicatedOk = testDedicated();
+
+    if (poolOk && dedicatedOk) {
+        cout << "Correctness test passed with " << CLIENT_THREADS << " client threads" << endl;
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,213 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <algorithm>
+#include <string>
+
+#include "DelegationLock.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// A latency-critical client shares one DelegationLock with bulk clients that
+// keep it saturated. Reports the critical client's p50/p99 with everything in
+// one FIFO lane, with strict priority lanes and with earliest-deadline-first,
+// and what bulk traffic gets in each case.
+
+// Test parameters
+const int BULK_CLIENTS = 4;
+const int BULK_WINDOW = 32;            // Outstanding requests per bulk client
+const int BULK_WORK_ITERATIONS = 2000; // Critical section length of a bulk request
+const microseconds CRITICAL_GAP(200);
+const milliseconds RUN_LENGTH(300);
+const int STARVATION_LIMIT = 4;
+
+// Keeps the server busy until released, so requests queue up behind it
+struct Gate {
+    promise<void> started;
+    promise<void> release;
+
+    future<void> close(DelegationLock& lock) {
+        shared_future<void> open = release.get_future().share();
+        auto done = lock.async([this, open] {
+            started.set_value();
+            open.wait();
+        });
+        started.get_future().wait();
+        return done;
+    }
+};
+
+// Runs the requests queued by submit behind a gate and returns their labels
+// in the order the server ran them
+template <typename Submit>
+string runOrder(DelegationLock& lock, Submit submit) {
+    string order;
+    vector<future<void>> done;
+    Gate gate;
+    auto gateDone = gate.close(lock);
+    submit([&](char label) { return [&order, label] { order += label; }; }, done);
+    gate.release.set_value();
+    gateDone.wait();
+    for (auto& f : done) {
+        f.wait();
+    }
+    return order;
+}
+
+bool check(const char* test, const string& got, const string& expected) {
+    if (got != expected) {
+        cout << "Error: " << test << " ran " << got << ", expected " << expected << endl;
+        return false;
+    }
+    cout << "Correctness test passed: " << test << " (" << got << ")" << endl;
+    return true;
+}
+
+bool testOrdering() {
+    bool ok = true;
+    {
+        DelegationLock lock;
+        string order = runOrder(lock, [&](auto label, vector<future<void>>& done) {
+            done.push_back(lock.async(label('b'), Priority::Bulk));
+            done.push_back(lock.async(label('n'), Priority::Normal));
+            done.push_back(lock.async(label('h'), Priority::High));
+            done.push_back(lock.async(label('n')));
+            done.push_back(lock.async(label('h'), Priority::High));
+        });
+        ok = check("strict priority", order, "hhnnb") && ok;
+    }
+    {
+        DelegationLock lock;
+        lock.setScheduling(LaneScheduling::StrictPriority, STARVATION_LIMIT);
+        string order = runOrder(lock, [&](auto label, vector<future<void>>& done) {
+            done.push_back(lock.async(label('b'), Priority::Bulk));
+            for (int i = 0; i < 2 * STARVATION_LIMIT; ++i) {
+                done.push_back(lock.async(label('h'), Priority::High));
+            }
+        });
+        ok = check("bounded starvation", order, string(STARVATION_LIMIT, 'h') + "b" +
+                                                string(STARVATION_LIMIT, 'h')) && ok;
+    }
+    {
+        DelegationLock lock;
+        lock.setScheduling(LaneScheduling::EarliestDeadline);
+        auto now = steady_clock::now();
+        string order = runOrder(lock, [&](auto label, vector<future<void>>& done) {
+            done.push_back(lock.async(label('3'), now + milliseconds(30), Priority::High));
+            done.push_back(lock.async(label('1'), now + milliseconds(10), Priority::Bulk));
+            done.push_back(lock.async(label('2'), now + milliseconds(20)));
+        });
+        ok = check("earliest deadline", order, "123") && ok;
+    }
+    return ok;
+}
+
+struct MixedResult {
+    double p50Us = 0;
+    double p99Us = 0;
+    long bulkOps = 0;
+    double bulkMaxWaitUs = 0;
+};
+
+void bulkWork(long& state) {
+    for (int i = 0; i < BULK_WORK_ITERATIONS; ++i) {
+        state = state * 31 + i;
+    }
+}
+
+// mode: "fifo" puts the critical client in the bulk clients' lane
+MixedResult runMixed(const string& mode, long& counter, long& expected) {
+    DelegationLock lock;
+    Priority critical = Priority::High;
+    Priority bulk = Priority::Bulk;
+    if (mode == "fifo") {
+        critical = bulk = Priority::Normal;
+    } else if (mode == "edf") {
+        lock.setScheduling(LaneScheduling::EarliestDeadline);
+    }
+
+    atomic<bool> stop{false};
+    atomic<long> bulkOps{0};
+    atomic<uint64_t> bulkMaxWait{0};
+    long scratch = 0; // Only touched on the server
+
+    vector<thread> clients;
+    for (int t = 0; t < BULK_CLIENTS; ++t) {
+        clients.emplace_back([&] {
+            deque<pair<future<void>, uint64_t>> window;
+            long done = 0;
+            uint64_t maxWait = 0;
+            auto retire = [&] {
+                window.front().first.wait();
+                maxWait = max(maxWait, lockstats::nowNs() - window.front().second);
+                window.pop_front();
+                done++;
+            };
+            while (!stop.load(memory_order_relaxed)) {
+                if (window.size() == (size_t)BULK_WINDOW) {
+                    retire();
+                }
+                window.emplace_back(lock.async([&] { bulkWork(scratch); counter++; }, bulk),
+                                    lockstats::nowNs());
+            }
+            while (!window.empty()) {
+                retire();
+            }
+            bulkOps += done;
+            uint64_t seen = bulkMaxWait.load();
+            while (maxWait > seen && !bulkMaxWait.compare_exchange_weak(seen, maxWait)) {
+            }
+        });
+    }
+
+    vector<uint64_t> latencies;
+    auto until = steady_clock::now() + RUN_LENGTH;
+    while (steady_clock::now() < until) {
+        uint64_t start = lockstats::nowNs();
+        lock.async([&] { counter++; }, critical).wait();
+        latencies.push_back(lockstats::nowNs() - start);
+        this_thread::sleep_for(CRITICAL_GAP);
+    }
+    stop = true;
+    for (auto& t : clients) {
+        t.join();
+    }
+
+    sort(latencies.begin(), latencies.end());
+    MixedResult r;
+    r.p50Us = latencies[latencies.size() / 2] / 1000.0;
+    r.p99Us = latencies[latencies.size() * 99 / 100] / 1000.0;
+    r.bulkOps = bulkOps;
+    r.bulkMaxWaitUs = bulkMaxWait / 1000.0;
+    expected += r.bulkOps + (long)latencies.size();
+    return r;
+}
+
+int main() {
+    cout << "Correctness testing:\n";
+    bool ok = testOrdering();
+
+    cout << "\nPerformance testing:\n";
+    long counter = 0, expected = 0;
+    for (const string mode : {"fifo", "strict", "edf"}) {
+        MixedResult r = runMixed(mode, counter, expected);
+        cout << "Scheduling: " << mode << fixed << setprecision(1)
+             << ", Critical p50: " << r.p50Us << " us, p99: " << r.p99Us << " us"
+             << ", Bulk throughput: " << r.bulkOps * 1000 / RUN_LENGTH.count() << " ops/sec"
+             << ", Bulk max wait: " << r.bulkMaxWaitUs << " us" << endl;
+    }
+    if (counter != expected) {
+        cout << "Error: Expected counter " << expected << ", got " << counter << endl;
+        ok = false;
+    } else {
+        cout << "Correctness test passed: no requests lost in any lane" << endl;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <random>
+
+#include "DelegationLock.h"
+#include "NodeReplicated.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// A table of counters behind one DelegationLock server versus node
+// replication over a faked topology of 1, 2 and 4 nodes (client c on node
+// c % nodes), at several read ratios. On a single socket this measures the
+// protocol's cost and its read scaling, not remote-socket savings.
+
+// Test parameters
+const int KEYS = 1024;
+const int CLIENT_THREADS = 8;
+const int OPERATIONS_PER_THREAD = 20000;
+const int NODE_COUNTS[] = {1, 2, 4};
+const int READ_PERCENTS[] = {50, 90, 99};
+
+struct Table {
+    long values[KEYS] = {};
+};
+
+struct Add {
+    int key;
+    long delta;
+    long operator()(Table& t) const { return t.values[key] += delta; }
+};
+
+using ReplicatedTable = NodeReplicated<Table, Add>;
+
+// Same stream for every engine: op i of thread id reads or adds id + 1
+struct Workload {
+    int readPercent;
+
+    template <typename Read, typename Write>
+    void run(int id, Read read, Write write) const {
+        mt19937 rng(id + 1);
+        uniform_int_distribution<int> key(0, KEYS - 1), percent(0, 99);
+        for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+            int k = key(rng);
+            if (percent(rng) < readPercent) {
+                read(k);
+            } else {
+                write(Add{k, id + 1});
+            }
+        }
+    }
+
+    Table expected() const {
+        Table t;
+        for (int id = 0; id < CLIENT_THREADS; ++id) {
+            run(id, [](int) {}, [&t](const Add& op) { op(t); });
+        }
+        return t;
+    }
+};
+
+bool sameTable(const Table& a, const Table& b) {
+    for (int k = 0; k < KEYS; ++k) {
+        if (a.values[k] != b.values[k]) return false;
+    }
+    return true;
+}
+
+template <typename Client>
+long runThreads(Client client) {
+    auto start = high_resolution_clock::now();
+    vector<thread> threads;
+    for (int id = 0; id < CLIENT_THREADS; ++id) {
+        threads.emplace_back(client, id);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    return duration_cast<nanoseconds>(high_resolution_clock::now() - start).count();
+}
+
+void report(const string& engine, int readPercent, long ns) {
+    long total = (long)CLIENT_THREADS * OPERATIONS_PER_THREAD;
+    cout << "Engine: " << engine << ", Reads: " << readPercent << "%"
+         << ", Time: " << ns / 1000000 << " ms"
+         << ", Throughput: " << (long)(total * 1e9 / ns) << " ops/sec" << endl;
+}
+
+bool testReadPercent(int readPercent) {
+    Workload workload{readPercent};
+    Table expected = workload.expected();
+    bool ok = true;
+
+    {
+        DelegationLock lock;
+        Table table;
+        long ns = runThreads([&](int id) {
+            long sink = 0;
+            workload.run(id,
+                [&](int k) { lock.async([&, k] { sink += table.values[k]; }).wait(); },
+                [&](const Add& op) { lock.async([&, op] { op(table); }).wait(); });
+        });
+        report("DelegationLock", readPercent, ns);
+        ok = sameTable(table, expected) && ok;
+    }
+
+    for (int nodes : NODE_COUNTS) {
+        ReplicatedTable nr(nodes);
+        long ns = runThreads([&](int id) {
+            ReplicatedTable::Client* client = nr.attach(id % nodes);
+            long sink = 0;
+            workload.run(id,
+                [&](int k) { sink += client->read([k](const Table& t) { return t.values[k]; }); },
+                [&](const Add& op) { client->execute(op); });
+        });
+        report("NodeReplicated, " + to_string(nodes) + " nodes", readPercent, ns);
+
+        nr.sync();
+        for (int n = 0; n < nodes; ++n) {
+            if (!sameTable(nr.unsafeReplica(n), expected)) {
+                cout << "Error: replica " << n << " of " << nodes << " diverged" << endl;
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+// Every thread adds 1 to one key and reads it back: a read after a write on
+// the same node must see at least that many of the thread's own writes
+bool testReadYourWrites() {
+    ReplicatedTable nr(4);
+    atomic<bool> ok{true};
+    runThreads([&](int id) {
+        ReplicatedTable::Client* client = nr.attach(id % 4);
+        for (int i = 1; i <= OPERATIONS_PER_THREAD / 10; ++i) {
+            client->execute(Add{id, 1});
+            if (client->read([id](const Table& t) { return t.values[id]; }) < i) {
+                ok = false;
+            }
+        }
+    });
+    return ok;
+}
+
+int main() {
+    cout << "Correctness testing:\n";
+    bool ok = testReadYourWrites();
+    if (ok) {
+        cout << "Correctness test passed: reads see the reader's own writes" << endl;
+    } else {
+        cout << "Error: a read missed the reader's own write" << endl;
+    }
+
+    cout << "\nPerformance testing:\n";
+    bool tablesOk = true;
+    for (int readPercent : READ_PERCENTS) {
+        tablesOk = testReadPercent(readPercent) && tablesOk;
+    }
+    if (tablesOk) {
+        cout << "Correctness test passed: every replica matches the sequential result" << endl;
+    }
+
+    return ok && tablesOk ? 0 : 1;
+}
@@ -0,0 +1,188 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <future>
+#include <stdexcept>
+
+#include "DelegationLock.h"
+#include "ShardedDelegation.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Bank transfers between accounts spread over shards (account a lives on
+// shard a % SHARDS). A transfer between shards is a two-shard atomic
+// operation; auditors meanwhile sum every balance with an all-shard
+// operation, which must always see the opening total. Compared with one
+// DelegationLock server holding every account, at several cross-shard
+// fractions.
+
+// Test parameters
+const int ACCOUNTS = 4096;
+const int SHARDS = 4;
+const long OPENING_BALANCE = 1000;
+const int CLIENT_THREADS = 4;
+const int WINDOW = 16;                 // Transfers in flight per client
+const int TRANSFERS_PER_THREAD = 10000;
+const int AUDITS = 50;
+const double CROSS_FRACTIONS[] = {0.0, 0.1, 0.5, 1.0};
+
+using Balances = vector<long>; // One shard's accounts, indexed by account / SHARDS
+
+struct Transfer {
+    int from;
+    int to;
+    long amount;
+};
+
+void transfer(long& from, long& to, long amount) {
+    // Never overdraw, so every transfer's effect depends on the order
+    long moved = min(amount, from);
+    from -= moved;
+    to += moved;
+}
+
+vector<Transfer> makeTransfers(int id, double crossFraction) {
+    mt19937 rng(id + 1);
+    uniform_int_distribution<int> account(0, ACCOUNTS - 1), shard(1, SHARDS - 1);
+    uniform_int_distribution<long> amount(1, 100);
+    bernoulli_distribution cross(crossFraction);
+    vector<Transfer> transfers(TRANSFERS_PER_THREAD);
+    for (auto& t : transfers) {
+        t.from = account(rng);
+        // Same shard, or a different one, as the fraction says
+        int offset = cross(rng) ? shard(rng) : 0;
+        t.to = (t.from + offset + SHARDS * (account(rng) / SHARDS)) % ACCOUNTS;
+        if (t.to == t.from) t.to = (t.to + SHARDS) % ACCOUNTS;
+        t.amount = amount(rng);
+    }
+    return transfers;
+}
+
+template <typename Submit>
+long runClients(double crossFraction, Submit submit) {
+    vector<vector<Transfer>> transfers;
+    for (int id = 0; id < CLIENT_THREADS; ++id) {
+        transfers.push_back(makeTransfers(id, crossFraction));
+    }
+    auto start = high_resolution_clock::now();
+    vector<thread> threads;
+    for (int id = 0; id < CLIENT_THREADS; ++id) {
+        threads.emplace_back([&, id] {
+            deque<future<void>> window;
+            for (const Transfer& t : transfers[id]) {
+                if (window.size() == (size_t)WINDOW) {
+                    window.front().wait();
+                    window.pop_front();
+                }
+                window.push_back(submit(t));
+            }
+            for (auto& f : window) f.wait();
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    return duration_cast<nanoseconds>(high_resolution_clock::now() - start).count();
+}
+
+void report(const char* engine, double crossFraction, long ns) {
+    long total = (long)CLIENT_THREADS * TRANSFERS_PER_THREAD;
+    cout << "Engine: " << engine << ", Cross-shard: " << fixed << setprecision(1)
+         << crossFraction * 100 << "%, Time: " << ns / 1000000 << " ms"
+         << ", Throughput: " << (long)(total * 1e9 / ns) << " transfers/sec" << endl;
+}
+
+bool testSharded(double crossFraction) {
+    ShardedDelegation<Balances> bank(SHARDS);
+    for (int s = 0; s < SHARDS; ++s) {
+        bank.unsafeState(s).assign(ACCOUNTS / SHARDS, OPENING_BALANCE);
+    }
+    vector<int> allShards;
+    for (int s = 0; s < SHARDS; ++s) allShards.push_back(s);
+
+    atomic<bool> auditing{true};
+    atomic<int> badAudits{0};
+    thread auditor([&] {
+        for (int i = 0; i < AUDITS && auditing; ++i) {
+            long sum = 0;
+            bank.asyncMulti(allShards, [&sum](vector<Balances*>& states) {
+                for (Balances* b : states) {
+                    for (long v : *b) sum += v;
+                }
+            }).wait();
+            if (sum != (long)ACCOUNTS * OPENING_BALANCE) badAudits++;
+            this_thread::sleep_for(milliseconds(1));
+        }
+    });
+
+    long ns = runClients(crossFraction, [&](const Transfer& t) {
+        int fromShard = t.from % SHARDS, toShard = t.to % SHARDS;
+        int fromIndex = t.from / SHARDS, toIndex = t.to / SHARDS;
+        if (fromShard == toShard) {
+            return bank.async(fromShard, [=](Balances& b) { transfer(b[fromIndex], b[toIndex], t.amount); });
+        }
+        return bank.asyncMulti({fromShard, toShard}, [=](vector<Balances*>& states) {
+            transfer((*states[0])[fromIndex], (*states[1])[toIndex], t.amount);
+        });
+    });
+    auditing = false;
+    auditor.join();
+    report("ShardedDelegation", crossFraction, ns);
+
+    long sum = 0;
+    for (int s = 0; s < SHARDS; ++s) {
+        for (long v : bank.unsafeState(s)) sum += v;
+    }
+    if (badAudits > 0 || sum != (long)ACCOUNTS * OPENING_BALANCE) {
+        cout << "Error: " << badAudits << " audits saw a partial transfer; final total " << sum << endl;
+        return false;
+    }
+    return true;
+}
+
+// Empty, duplicate and out-of-range shard lists fail the future instead of
+// running
+bool testBadShardLists() {
+    ShardedDelegation<Balances> bank(SHARDS);
+    bool ok = true;
+    for (const vector<int>& list : {vector<int>{}, vector<int>{1, 2, 1}, vector<int>{0, SHARDS}}) {
+        bool ran = false;
+        try {
+            bank.asyncMulti(list, [&ran](vector<Balances*>&) { ran = true; }).get();
+            ok = false;
+        } catch (const invalid_argument&) {
+        }
+        if (ran) ok = false;
+    }
+    if (!ok) cout << "Error: asyncMulti accepted a bad shard list" << endl;
+    return ok;
+}
+
+void testSingleServer(double crossFraction) {
+    DelegationLock lock;
+    vector<long> balances(ACCOUNTS, OPENING_BALANCE);
+    long ns = runClients(crossFraction, [&](const Transfer& t) {
+        return lock.async([&balances, t] { transfer(balances[t.from], balances[t.to], t.amount); });
+    });
+    report("DelegationLock (one server)", crossFraction, ns);
+}
+
+int main() {
+    bool ok = testBadShardLists();
+    for (double crossFraction : CROSS_FRACTIONS) {
+        testSingleServer(crossFraction);
+        ok = testSharded(crossFraction) && ok;
+    }
+
+    if (ok) {
+        cout << "Correctness test passed: every audit saw the opening total" << endl;
+        return 0;
+    }
+    return 1;
+}
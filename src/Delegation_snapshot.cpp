@@ -0,0 +1,154 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <future>
+#include <algorithm>
+#include <string>
+#include <unistd.h>
+
+#include "DelegationLock.h"
+#include "Snapshot.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Clients update a large table through one DelegationLock server while
+// snapshots are written back to back, by forking or by copying. Reports
+// throughput and p99 latency with no snapshots and under each method, how
+// long the server was paused, and checks every snapshot is consistent.
+
+// Test parameters
+const size_t VALUES = 4 << 20;      // 32 MB of state
+const int CLIENT_THREADS = 4;
+const int WINDOW = 8;               // Requests in flight per client
+const milliseconds PHASE_LENGTH(600);
+
+// Every update adds 1 to a value and to the update count, so a snapshot
+// is consistent if its values add up to its count
+struct Table {
+    long updates = 0;
+    vector<long> values = vector<long>(VALUES, 0);
+
+    vector<SnapshotRegion> regions() {
+        return {{&updates, sizeof(updates)}, {values.data(), values.size() * sizeof(long)}};
+    }
+};
+
+struct PhaseResult {
+    long ops = 0;
+    double p99Us = 0;
+    int snapshots = 0;
+    bool snapshotsOk = true;
+    double maxPauseMs = 0;
+    double meanSnapshotMs = 0;
+};
+
+bool checkSnapshot(const string& path) {
+    Table loaded;
+    if (!snapshot::load(path.c_str(), loaded.regions())) return false;
+    long sum = 0;
+    for (long v : loaded.values) sum += v;
+    return sum == loaded.updates;
+}
+
+PhaseResult runPhase(DelegationLock& lock, Table& table, bool snapshots, SnapshotMethod method) {
+    atomic<bool> stop{false};
+    vector<vector<uint64_t>> latencies(CLIENT_THREADS);
+    vector<thread> threads;
+    for (int t = 0; t < CLIENT_THREADS; ++t) {
+        threads.emplace_back([&, t] {
+            mt19937 rng(t + 1);
+            uniform_int_distribution<size_t> index(0, VALUES - 1);
+            deque<pair<future<void>, uint64_t>> window;
+            auto retire = [&] {
+                window.front().first.wait();
+                latencies[t].push_back(lockstats::nowNs() - window.front().second);
+                window.pop_front();
+            };
+            while (!stop.load(memory_order_relaxed)) {
+                if (window.size() == (size_t)WINDOW) retire();
+                size_t i = index(rng);
+                window.emplace_back(lock.async([&table, i] {
+                    table.values[i]++;
+                    table.updates++;
+                }), lockstats::nowNs());
+            }
+            while (!window.empty()) retire();
+        });
+    }
+
+    PhaseResult r;
+    auto until = steady_clock::now() + PHASE_LENGTH;
+    if (snapshots) {
+        Snapshotter snapshotter(lock, table.regions());
+        string path = "/tmp/delegation_snapshot_" + to_string(getpid()) + ".snap";
+        double totalMs = 0;
+        while (steady_clock::now() < until) {
+            SnapshotResult s = snapshotter.take(path, method).get();
+            r.snapshots++;
+            r.snapshotsOk = r.snapshotsOk && s.ok && checkSnapshot(path);
+            r.maxPauseMs = max(r.maxPauseMs, s.pauseNs / 1e6);
+            totalMs += s.totalNs / 1e6;
+        }
+        r.meanSnapshotMs = r.snapshots ? totalMs / r.snapshots : 0;
+        unlink(path.c_str());
+    } else {
+        this_thread::sleep_until(until);
+    }
+    stop = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    vector<uint64_t> all;
+    for (auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+    sort(all.begin(), all.end());
+    r.ops = all.size();
+    r.p99Us = all.empty() ? 0 : all[all.size() * 99 / 100] / 1000.0;
+    return r;
+}
+
+int main() {
+    Table table;
+    DelegationLock lock;
+
+    struct Phase {
+        const char* name;
+        bool snapshots;
+        SnapshotMethod method;
+    };
+    const Phase phases[] = {
+        {"none", false, SnapshotMethod::Copy},
+        {"fork", true, SnapshotMethod::Fork},
+        {"copy", true, SnapshotMethod::Copy},
+    };
+
+    bool ok = true;
+    for (const Phase& phase : phases) {
+        PhaseResult r = runPhase(lock, table, phase.snapshots, phase.method);
+        cout << "Snapshots: " << phase.name << fixed << setprecision(1)
+             << ", Throughput: " << r.ops * 1000 / PHASE_LENGTH.count() << " ops/sec"
+             << ", p99: " << r.p99Us << " us";
+        if (phase.snapshots) {
+            cout << ", Taken: " << r.snapshots << " (" << VALUES * sizeof(long) / (1 << 20) << " MB each)"
+                 << ", Mean time: " << r.meanSnapshotMs << " ms"
+                 << ", Max server pause: " << r.maxPauseMs << " ms";
+        }
+        cout << endl;
+        if (!r.snapshotsOk) {
+            cout << "Error: a " << phase.name << " snapshot failed or was inconsistent" << endl;
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        cout << "Correctness test passed: every snapshot was consistent" << endl;
+        return 0;
+    }
+    return 1;
+}
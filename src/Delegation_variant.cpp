@@ -0,0 +1,237 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <functional>
+
+#include "DelegationLock.h"
+#include "DelegationServer.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Delegated state and a closed set of operations on it
+struct State {
+    long counter = 0;
+    long checksum = 0;
+};
+
+struct Add {
+    long delta;
+    long operator()(State& s) const { return s.counter += delta; }
+};
+
+struct Sub {
+    long delta;
+    long operator()(State& s) const { return s.counter -= delta; }
+};
+
+struct Xor {
+    long value;
+    long operator()(State& s) const { return s.checksum ^= value; }
+};
+
+struct Get {
+    long operator()(State& s) const { return s.counter; }
+};
+
+// Same transport, but dispatched through std::function like DelegationLock
+struct FunctionOp {
+    function<long(State&)> work;
+    long operator()(State& s) const { return work(s); }
+};
+
+using VariantServer = DelegationServer<State, Add, Sub, Xor, Get>;
+using FunctionServer = DelegationServer<State, FunctionOp>;
+
+// Test parameters
+const int OPERATIONS_PER_THREAD = 10000;
+const int MAX_THREADS = 8;
+const int DISPATCH_OPERATIONS = 1 << 20;
+
+// Mixed operation stream: op i of thread id is Add, Sub, Xor or Get
+int opKind(int id, int i) {
+    return (i * 7 + id) % 4;
+}
+
+long xorValue(int id, int i) {
+    return (long)id << 32 | i;
+}
+
+void variantClient(VariantServer& server, int id) {
+    for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+        switch (opKind(id, i)) {
+            case 0: server.call(Add{2}); break;
+            case 1: server.call(Sub{1}); break;
+            case 2: server.call(Xor{xorValue(id, i)}); break;
+            default: server.call(Get{}); break;
+        }
+    }
+}
+
+void functionClient(FunctionServer& server, int id) {
+    for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+        long x = xorValue(id, i);
+        switch (opKind(id, i)) {
+            case 0: server.call(FunctionOp{[](State& s) { return s.counter += 2; }}); break;
+            case 1: server.call(FunctionOp{[](State& s) { return s.counter -= 1; }}); break;
+            case 2: server.call(FunctionOp{[x](State& s) { return s.checksum ^= x; }}); break;
+            default: server.call(FunctionOp{[](State& s) { return s.counter; }}); break;
+        }
+    }
+}
+
+void delegationClient(DelegationLock& lock, State& state, int id) {
+    for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+        long x = xorValue(id, i);
+        switch (opKind(id, i)) {
+            case 0: lock.async([&state] { state.counter += 2; }).wait(); break;
+            case 1: lock.async([&state] { state.counter -= 1; }).wait(); break;
+            case 2: lock.async([&state, x] { state.checksum ^= x; }).wait(); break;
+            default: lock.async([&state] { (void)state.counter; }).wait(); break;
+        }
+    }
+}
+
+State expectedState(int threadCount) {
+    State s;
+    for (int id = 0; id < threadCount; ++id) {
+        for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+            switch (opKind(id, i)) {
+                case 0: s.counter += 2; break;
+                case 1: s.counter -= 1; break;
+                case 2: s.checksum ^= xorValue(id, i); break;
+                default: break;
+            }
+        }
+    }
+    return s;
+}
+
+template <typename Server, typename Client>
+long runClients(Server& server, int threadCount, Client client) {
+    auto start = high_resolution_clock::now();
+    vector<thread> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back(client, ref(server), i);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    return duration_cast<nanoseconds>(high_resolution_clock::now() - start).count();
+}
+
+bool testCorrectness(int threadCount) {
+    State expected = expectedState(threadCount);
+    VariantServer variantServer;
+    FunctionServer functionServer;
+    runClients(variantServer, threadCount, variantClient);
+    runClients(functionServer, threadCount, functionClient);
+
+    bool ok = true;
+    for (const State* s : {&variantServer.unsafeState(), &functionServer.unsafeState()}) {
+        ok = ok && s->counter == expected.counter && s->checksum == expected.checksum;
+    }
+    if (!ok) {
+        cout << "Error: Expected counter " << expected.counter << ", got "
+             << variantServer.unsafeState().counter << " (variant) and "
+             << functionServer.unsafeState().counter << " (std::function)" << endl;
+    } else {
+        cout << "Correctness test passed with " << threadCount << " threads" << endl;
+    }
+    return ok;
+}
+
+// Server-side dispatch alone, single-threaded: a mixed stream of requests
+// through the generated switch versus through std::function; false if their
+// results differ
+bool testDispatch() {
+    mt19937 rng(42);
+    vector<VariantServer::Request> variants;
+    vector<function<long(State&)>> functions;
+    variants.reserve(DISPATCH_OPERATIONS);
+    functions.reserve(DISPATCH_OPERATIONS);
+    for (int i = 0; i < DISPATCH_OPERATIONS; ++i) {
+        long x = rng();
+        switch (rng() % 4) {
+            case 0:
+                variants.emplace_back(Add{2});
+                functions.emplace_back([](State& s) { return s.counter += 2; });
+                break;
+            case 1:
+                variants.emplace_back(Sub{1});
+                functions.emplace_back([](State& s) { return s.counter -= 1; });
+                break;
+            case 2:
+                variants.emplace_back(Xor{x});
+                functions.emplace_back([x](State& s) { return s.checksum ^= x; });
+                break;
+            default:
+                variants.emplace_back(Get{});
+                functions.emplace_back([](State& s) { return s.counter; });
+                break;
+        }
+    }
+
+    State a, b;
+    long sinkA = 0, sinkB = 0;
+    auto start = high_resolution_clock::now();
+    for (auto& op : variants) {
+        sinkA += VariantServer::apply(op, a);
+    }
+    auto mid = high_resolution_clock::now();
+    for (auto& f : functions) {
+        sinkB += f(b);
+    }
+    auto end = high_resolution_clock::now();
+
+    double variantNs = duration<double, nano>(mid - start).count() / DISPATCH_OPERATIONS;
+    double functionNs = duration<double, nano>(end - mid).count() / DISPATCH_OPERATIONS;
+    cout << "Dispatch only: variant switch " << variantNs << " ns/op, std::function "
+         << functionNs << " ns/op" << (sinkA == sinkB ? "" : " (Error: results differ)") << endl;
+    return sinkA == sinkB;
+}
+
+void testPerformance(int threadCount) {
+    long total = (long)threadCount * OPERATIONS_PER_THREAD;
+
+    DelegationLock lock;
+    State lockState;
+    auto start = high_resolution_clock::now();
+    vector<thread> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back(delegationClient, ref(lock), ref(lockState), i);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    long lockNs = duration_cast<nanoseconds>(high_resolution_clock::now() - start).count();
+
+    FunctionServer functionServer;
+    long functionNs = runClients(functionServer, threadCount, functionClient);
+    VariantServer variantServer;
+    long variantNs = runClients(variantServer, threadCount, variantClient);
+
+    cout << "Threads: " << threadCount
+         << ", DelegationLock: " << lockNs / total << " ns/op"
+         << ", DelegationServer<std::function>: " << functionNs / total << " ns/op"
+         << ", DelegationServer<variant>: " << variantNs / total << " ns/op" << endl;
+}
+
+int main() {
+    cout << "Correctness testing:\n";
+    bool ok = true;
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+        ok = testCorrectness(threads) && ok;
+    }
+
+    cout << "\nPerformance testing:\n";
+    ok = testDispatch() && ok;
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+        testPerformance(threads);
+    }
+
+    return ok ? 0 : 1;
+}
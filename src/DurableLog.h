@@ -0,0 +1,224 @@
+#pragma once
+
+// A preallocated, memory-mapped write-ahead log with group commit.
+//
+// File layout: one page holding a LogHeader, then records back to back,
+// each a RecordHeader and its payload padded to 8 bytes. Appending copies
+// into the mapping; sync() msyncs everything appended since the last sync,
+// so one call makes a whole batch durable.
+//
+// A record is valid if its LSN is the next one expected, its CRC matches and
+// its epoch is not older than the previous record's. Every open bumps the
+// epoch, so when a log is reopened after a crash and appended to, records
+// left over from before the crash beyond the new tail are never mistaken
+// for new ones. Recovery stops at the first invalid record.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace durablelog {
+
+const uint32_t LOG_MAGIC = 0x474f4c44; // "DLOG"
+const uint32_t LOG_VERSION = 1;
+const size_t LOG_PAGE = 4096;
+const size_t MAX_RECORD_LENGTH = UINT32_MAX; // RecordHeader::length is 32 bits
+
+struct LogHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t epoch;
+    uint32_t reserved;
+    uint64_t capacity; // File size in bytes, header page included
+};
+
+struct RecordHeader {
+    uint32_t length; // Payload bytes
+    uint32_t crc;    // Over epoch, lsn and payload
+    uint32_t epoch;
+    uint32_t reserved;
+    uint64_t lsn;
+};
+
+inline uint32_t crc32(uint32_t crc, const void* data, size_t length) {
+    static const struct Table {
+        uint32_t entries[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+                entries[i] = c;
+            }
+        }
+    } table;
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i) crc = table.entries[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline uint32_t recordCrc(const RecordHeader& h, const void* payload) {
+    uint32_t crc = crc32(0, &h.epoch, sizeof(h.epoch));
+    crc = crc32(crc, &h.lsn, sizeof(h.lsn));
+    return crc32(crc, payload, h.length);
+}
+
+inline size_t recordSize(size_t length) {
+    return (sizeof(RecordHeader) + length + 7) & ~size_t(7);
+}
+
+// Calls f(lsn, payload, length) for each valid record of a mapped log from
+// the start; returns the offset just past the last one.
+template <typename F>
+size_t scanRecords(const uint8_t* base, size_t capacity, F f) {
+    size_t offset = LOG_PAGE;
+    uint64_t lsn = 0;
+    uint32_t epoch = 0;
+    while (offset + sizeof(RecordHeader) <= capacity) {
+        RecordHeader h;
+        std::memcpy(&h, base + offset, sizeof(h));
+        if (h.lsn != lsn || h.epoch < epoch || h.epoch == 0 ||
+            offset + recordSize(h.length) > capacity ||
+            h.crc != recordCrc(h, base + offset + sizeof(h))) {
+            break;
+        }
+        f(h.lsn, base + offset + sizeof(h), h.length);
+        offset += recordSize(h.length);
+        epoch = h.epoch;
+        lsn++;
+    }
+    return offset;
+}
+
+// One writer: in a DelegationLock, its server thread.
+class LogFile {
+private:
+    int fd = -1;
+    uint8_t* base = nullptr;
+    size_t capacity = 0;
+    size_t tail = LOG_PAGE;   // End of the last record
+    size_t synced = LOG_PAGE; // End of what the last sync covered
+    uint64_t nextLsn = 0;
+    uint32_t epoch = 0;
+    uint64_t syncs = 0;
+
+    LogHeader* header() { return reinterpret_cast<LogHeader*>(base); }
+
+public:
+    // Opens the log at path, creating and preallocating capacity bytes if it
+    // does not exist, and positions appends after its last valid record.
+    LogFile(const char* path, size_t capacityBytes) {
+        fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) != 0) return;
+        bool created = st.st_size == 0;
+        if (created) {
+            capacity = std::max<size_t>((capacityBytes + LOG_PAGE - 1) & ~(LOG_PAGE - 1), 2 * LOG_PAGE);
+            if (posix_fallocate(fd, 0, capacity) != 0) return;
+        } else {
+            capacity = st.st_size;
+        }
+        void* mem = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mem == MAP_FAILED) return;
+        base = static_cast<uint8_t*>(mem);
+
+        if (created) {
+            *header() = LogHeader{LOG_MAGIC, LOG_VERSION, 0, 0, capacity};
+        } else if (header()->magic != LOG_MAGIC || header()->version != LOG_VERSION ||
+                   header()->capacity != capacity) {
+            munmap(base, capacity);
+            base = nullptr;
+            return;
+        }
+        madvise(base, capacity, MADV_SEQUENTIAL);
+        tail = synced = scanRecords(base, capacity, [this](uint64_t lsn, const void*, size_t) {
+            nextLsn = lsn + 1;
+        });
+        epoch = header()->epoch + 1;
+        header()->epoch = epoch;
+        msync(base, LOG_PAGE, MS_SYNC);
+    }
+
+    ~LogFile() {
+        if (base) {
+            sync();
+            munmap(base, capacity);
+        }
+        if (fd >= 0) close(fd);
+    }
+
+    LogFile(const LogFile&) = delete;
+    LogFile& operator=(const LogFile&) = delete;
+
+    bool valid() const { return base != nullptr; }
+
+    // Not durable until the next sync(). Returns false if the log is full
+    // or length exceeds MAX_RECORD_LENGTH.
+    bool append(const void* payload, size_t length) {
+        if (length > MAX_RECORD_LENGTH) return false;
+        size_t size = recordSize(length);
+        if (tail + size > capacity) return false;
+        RecordHeader h{(uint32_t)length, 0, epoch, 0, nextLsn};
+        h.crc = recordCrc(h, payload);
+        std::memcpy(base + tail + sizeof(h), payload, length);
+        std::memcpy(base + tail, &h, sizeof(h));
+        tail += size;
+        nextLsn++;
+        return true;
+    }
+
+    // Makes every record appended so far durable. Returns false, with errno
+    // set, if the write-back failed; the records then count as unsynced and
+    // the next call tries them again.
+    bool sync() {
+        if (synced == tail) return true;
+        size_t from = synced & ~(LOG_PAGE - 1);
+        if (msync(base + from, tail - from, MS_SYNC) != 0) return false;
+        synced = tail;
+        syncs++;
+        return true;
+    }
+
+    uint64_t recordCount() const { return nextLsn; }
+    uint64_t syncCount() const { return syncs; }
+    size_t bytesUsed() const { return tail; }
+    size_t bytesFree() const { return capacity - tail; }
+};
+
+// Replays a log file read-only; returns the number of valid records, or -1
+// if the file is not a log.
+template <typename F>
+long replay(const char* path, F f) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    void* mem = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)(2 * LOG_PAGE)) {
+        mem = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mem == MAP_FAILED) return -1;
+
+    const uint8_t* base = static_cast<const uint8_t*>(mem);
+    LogHeader h;
+    std::memcpy(&h, base, sizeof(h));
+    long count = -1;
+    if (h.magic == LOG_MAGIC && h.version == LOG_VERSION && h.capacity == (uint64_t)st.st_size) {
+        madvise(mem, st.st_size, MADV_SEQUENTIAL);
+        count = 0;
+        scanRecords(base, st.st_size, [&](uint64_t lsn, const void* payload, size_t length) {
+            f(lsn, payload, length);
+            count++;
+        });
+    }
+    munmap(mem, st.st_size);
+    return count;
+}
+
+} // namespace durablelog
@@ -0,0 +1,145 @@
+#pragma once
+
+// A bakery lock that shares lock time between tenants in proportion to
+// their weights.
+//
+// Tickets are start-time fair queuing tags instead of max + 1. Each tenant
+// has a finish tag; a thread's ticket is max(virtual time, its tenant's
+// finish tag), and taking it advances the finish tag by the expected hold
+// time over the weight. Unlock corrects that by the actual hold time. The
+// virtual time is the largest ticket to have entered, so an idle
+// tenant comes back at the current virtual time instead of with credit it
+// saved up. Waiters still enter lowest ticket first, so a tenant that has
+// held the lock longer than its share queues behind the others however
+// many threads it has.
+//
+// A plain bakery is safe because a thread that arrives while another is
+// inside takes a larger ticket. Tags do not guarantee that, so a thread
+// that has waited out every earlier ticket first raises the virtual time to
+// its own ticket and then checks again. A newcomer either sees the raised
+// virtual time, and takes a later ticket, or is seen by the check.
+//
+// The tag arithmetic, the compare-and-swap on the tenant's finish tag and
+// the second scan make an entry dearer than BakeryLock's. How much dearer
+// depends on the host; Lamport_fairshare reports the ratio.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "Calibration.h"
+#include "LockStats.h"
+
+class FairShareBakeryLock {
+private:
+    // Virtual time per nanosecond of lock time at weight 1
+    static constexpr double TICKS_PER_NS = 16.0;
+
+    struct alignas(64) Tenant {
+        std::atomic<uint64_t> finish{0};
+        std::atomic<double> weight{1.0};
+        std::atomic<uint64_t> expectedNs{1000}; // Smoothed hold time
+    };
+
+    std::vector<std::atomic<bool>> choosing;
+    std::vector<std::atomic<uint64_t>> ticket;
+    std::vector<int> tenantOf;
+    std::vector<uint64_t> charged;  // Per thread: virtual time charged at lock()
+    std::vector<Tenant> tenants;
+    std::atomic<uint64_t> virtualTime{0};
+    uint64_t enteredNs = 0;
+    int threadCount;
+    lockstats::StatsWriter stats;
+    Calibration calib;
+
+    uint64_t cost(uint64_t ns, double weight) const {
+        return std::max<uint64_t>(1, (uint64_t)(ns * TICKS_PER_NS / weight));
+    }
+
+    // Whether a thread with an earlier ticket than id is present; waits out
+    // doorways in progress
+    bool anyEarlier(int id, uint64_t mine, bool wait, bool& contended) {
+        for (int i = 0; i < threadCount; ++i) {
+            if (i == id) continue;
+            SpinWait choosingWait(calib.spinBeforeYield, calib);
+            while (choosing[i]) {
+                contended = true;
+                choosingWait.once();
+            }
+            SpinWait ticketWait(calib.spinBeforeYield, calib);
+            for (;;) {
+                uint64_t theirs = ticket[i];
+                if (theirs == 0 || theirs > mine || (theirs == mine && i > id)) break;
+                contended = true;
+                if (!wait) return true;
+                ticketWait.once();
+            }
+        }
+        return false;
+    }
+
+public:
+    // n threads with ids 0..n-1; each starts as its own tenant (tenant id =
+    // thread id) with weight 1.
+    FairShareBakeryLock(int n, const Calibration& c = hostCalibration())
+        : choosing(n), ticket(n), tenantOf(n), charged(n, 0), tenants(n), threadCount(n),
+          stats("bakery", "FairShareBakeryLock"), calib(c) {
+        for (int i = 0; i < n; ++i) {
+            choosing[i] = false;
+            ticket[i] = 0;
+            tenantOf[i] = i;
+        }
+    }
+
+    // Call before thread id first locks. tenant is in 0..n-1.
+    void setTenant(int id, int tenant) { tenantOf[id] = tenant; }
+
+    // May be changed at any time; applies from each thread's next lock().
+    void setWeight(int tenant, double weight) { tenants[tenant].weight = std::max(weight, 1e-6); }
+
+    void lock(int id) {
+        uint64_t start = lockstats::nowNs();
+        bool contended = false;
+        Tenant& t = tenants[tenantOf[id]];
+
+        // Doorway: start tag after the virtual time and the tenant's last
+        // finish; the tenant's finish moves on by the expected cost
+        choosing[id] = true;
+        uint64_t charge = cost(t.expectedNs.load(std::memory_order_relaxed), t.weight.load(std::memory_order_relaxed));
+        uint64_t floor = virtualTime + 1;
+        uint64_t finish = t.finish;
+        uint64_t mine;
+        do {
+            mine = std::max(finish, floor);
+        } while (!t.finish.compare_exchange_weak(finish, mine + charge));
+        charged[id] = charge;
+        ticket[id] = mine;
+        choosing[id] = false;
+
+        for (;;) {
+            anyEarlier(id, mine, true, contended);
+            uint64_t v = virtualTime;
+            while (v < mine && !virtualTime.compare_exchange_weak(v, mine)) {
+            }
+            if (!anyEarlier(id, mine, false, contended)) break;
+        }
+
+        enteredNs = lockstats::nowNs();
+        stats.recordAcquire(contended, enteredNs - start);
+    }
+
+    void unlock(int id) {
+        uint64_t heldNs = lockstats::nowNs() - enteredNs;
+        Tenant& t = tenants[tenantOf[id]];
+        double weight = t.weight.load(std::memory_order_relaxed);
+        uint64_t expected = t.expectedNs.load(std::memory_order_relaxed);
+        t.expectedNs.store((expected * 7 + heldNs) / 8, std::memory_order_relaxed);
+
+        // Settle the charge against the hold time actually used
+        uint64_t actual = cost(heldNs, weight);
+        if (actual > charged[id]) t.finish += actual - charged[id];
+        else t.finish -= charged[id] - actual;
+        ticket[id] = 0;
+    }
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+// Group mutual exclusion on bakery tickets.
+//
+// Each thread enters for a session. Threads in the same session may be in
+// the critical section together; threads in different sessions exclude
+// each other. The doorway is the bakery's: take the largest ticket plus
+// one, and publish it with the session. A thread then waits only for
+// threads with an earlier ticket in another session. So threads in the
+// session that holds the lock walk straight in, and a thread that arrives
+// after a waiter from another session queues behind it. Sessions enter in
+// first-come first-served order, and no session can starve the others by
+// streaming in more of its own threads.
+
+#include <cstdint>
+
+#include "Calibration.h"
+#include "TicketWordBakery.h"
+
+class GroupBakeryLock {
+private:
+    struct OtherSession {
+        bool operator()(uint32_t mine, uint32_t theirs) const { return mine != theirs; }
+    };
+
+    TicketWordBakery<OtherSession> bakery;
+
+public:
+    GroupBakeryLock(int n, const Calibration& c = hostCalibration()) : bakery(n, "GroupBakeryLock", c) {}
+
+    void lock(int id, uint32_t session) { bakery.lock(id, session); }
+
+    void unlock(int id) { bakery.unlock(id); }
+
+    // For tests: whether thread id is waiting or inside
+    bool hasTicket(int id) const { return bakery.hasTicket(id); }
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+// k-exclusion on bakery tickets: up to k threads may be inside at once.
+//
+// The doorway is the bakery's. A thread may then enter once fewer than k
+// threads hold an earlier ticket, so the k lowest tickets are the ones
+// inside, and waiters enter first-come first-served. With k = 1 this is
+// BakeryLock.
+//
+// tryLock() and tryLockFor() give up by withdrawing their ticket, which to
+// everyone else looks like an entry that left at once.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "Calibration.h"
+#include "LockStats.h"
+
+class KExclusionBakeryLock {
+private:
+    std::vector<std::atomic<bool>> choosing;
+    std::vector<std::atomic<int>> ticket;
+    int threadCount;
+    int slots;
+    lockstats::SharedStatsWriter stats; // Up to k threads may be inside
+    Calibration calib;
+
+    void takeTicket(int id) {
+        choosing[id] = true;
+        int maxTicket = 0;
+        for (int i = 0; i < threadCount; ++i) {
+            maxTicket = std::max(maxTicket, ticket[i].load());
+        }
+        ticket[id] = maxTicket + 1;
+        choosing[id] = false;
+    }
+
+    // Whether fewer than k threads hold an earlier ticket than id's
+    bool mayEnter(int id, bool& contended) {
+        int mine = ticket[id];
+        int earlier = 0;
+        for (int i = 0; i < threadCount && earlier < slots; ++i) {
+            if (i == id) continue;
+            SpinWait choosingWait(calib.spinBeforeYield, calib);
+            while (choosing[i]) {
+                contended = true;
+                choosingWait.once();
+            }
+            int theirs = ticket[i];
+            if (theirs != 0 && (theirs < mine || (theirs == mine && i < id))) earlier++;
+        }
+        if (earlier >= slots) contended = true;
+        return earlier < slots;
+    }
+
+public:
+    // n threads with ids 0..n-1, of which k may be inside at once.
+    KExclusionBakeryLock(int n, int k, const Calibration& c = hostCalibration())
+        : choosing(n), ticket(n), threadCount(n), slots(std::max(k, 1)),
+          stats(n, "bakery", "KExclusionBakeryLock"), calib(c) {
+        for (int i = 0; i < n; ++i) {
+            choosing[i] = false;
+            ticket[i] = 0;
+        }
+    }
+
+    void lock(int id) {
+        uint64_t start = lockstats::nowNs();
+        bool contended = false;
+        takeTicket(id);
+        SpinWait wait(calib.spinBeforeYield, calib);
+        while (!mayEnter(id, contended)) {
+            wait.once();
+        }
+        stats.recordAcquire(id, contended, lockstats::nowNs() - start);
+    }
+
+    // Enters only if a slot is free for this ticket now.
+    bool tryLock(int id) {
+        uint64_t start = lockstats::nowNs();
+        bool contended = false;
+        takeTicket(id);
+        if (!mayEnter(id, contended)) {
+            ticket[id] = 0;
+            return false;
+        }
+        stats.recordAcquire(id, contended, lockstats::nowNs() - start);
+        return true;
+    }
+
+    // Waits in line up to timeout; false if it had to give up its place.
+    template <typename Rep, typename Period>
+    bool tryLockFor(int id, std::chrono::duration<Rep, Period> timeout) {
+        uint64_t start = lockstats::nowNs();
+        uint64_t deadline = start + std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+        bool contended = false;
+        takeTicket(id);
+        SpinWait wait(calib.spinBeforeYield, calib);
+        while (!mayEnter(id, contended)) {
+            if (lockstats::nowNs() >= deadline) {
+                ticket[id] = 0;
+                return false;
+            }
+            wait.once();
+        }
+        stats.recordAcquire(id, contended, lockstats::nowNs() - start);
+        return true;
+    }
+
+    void unlock(int id) {
+        ticket[id] = 0;
+    }
+
+    int limit() const { return slots; }
+
+    // For tests: whether thread id has taken a ticket, so is waiting or inside
+    bool hasTicket(int id) const { return ticket[id] != 0; }
+};
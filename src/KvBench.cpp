@@ -0,0 +1,496 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "LockEngines.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// A key-value server whose table is protected by a selectable lock engine,
+// and a load generator for it, to compare engines behind real request
+// handling rather than in a counter loop.
+//
+// Usage:
+//   KvBench                                        self-check over every engine
+//   KvBench serve ADDRESS [engine] [maxConnections]
+//   KvBench load ADDRESS [connections] [pipeline] [seconds] [theta] [keys]
+//
+// ADDRESS is a Unix-domain socket path (anything with a '/') or HOST:PORT
+// for TCP. Engines: lamport (the global bakery of Lamport.cpp), bakery,
+// delegation, mutex.
+//
+// The protocol is fixed-size binary messages: a Request per operation, a
+// Response per request, in order. A client may pipeline any number of
+// requests; the server answers every complete request it has read with
+// one write.
+
+// Test parameters
+const int DEFAULT_MAX_CONNECTIONS = 16;
+const int DEFAULT_CONNECTIONS = 8;
+const int DEFAULT_PIPELINE = 16;
+const double DEFAULT_THETA = 0.99;  // Zipfian skew; 0 is uniform
+const long DEFAULT_KEYS = 100000;
+const double GET_RATIO = 0.9;       // The rest are ADD 1
+const milliseconds SELF_CHECK_LENGTH(300);
+const char* const KV_ENGINES[] = {"lamport", "bakery", "delegation", "mutex"};
+
+enum : uint8_t { OP_GET = 1, OP_SET = 2, OP_ADD = 3 };
+enum : uint8_t { STATUS_OK = 0, STATUS_MISSING = 1, STATUS_BAD_REQUEST = 2 };
+
+struct Request {
+    uint8_t op;
+    uint8_t reserved[7];
+    uint64_t key;
+    int64_t value;
+};
+
+struct Response {
+    uint8_t status;
+    uint8_t reserved[7];
+    int64_t value; // GET: the value; SET, ADD: the new value
+};
+
+// --- Sockets ---
+
+// Fills addr for ADDRESS; returns false if it cannot be resolved
+bool resolve(const string& address, sockaddr_storage& addr, socklen_t& length) {
+    memset(&addr, 0, sizeof(addr));
+    if (address.find('/') != string::npos) {
+        sockaddr_un* un = reinterpret_cast<sockaddr_un*>(&addr);
+        if (address.size() >= sizeof(un->sun_path)) return false;
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, address.c_str());
+        length = sizeof(sockaddr_un);
+        return true;
+    }
+    size_t colon = address.rfind(':');
+    if (colon == string::npos) return false;
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    string host = colon == 0 ? "127.0.0.1" : address.substr(0, colon);
+    if (getaddrinfo(host.c_str(), address.substr(colon + 1).c_str(), &hints, &found) != 0) return false;
+    memcpy(&addr, found->ai_addr, found->ai_addrlen);
+    length = found->ai_addrlen;
+    freeaddrinfo(found);
+    return true;
+}
+
+void setNoDelay(int fd, const sockaddr_storage& addr) {
+    if (addr.ss_family == AF_INET) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+}
+
+int connectTo(const string& address) {
+    sockaddr_storage addr;
+    socklen_t length;
+    if (!resolve(address, addr, length)) return -1;
+    int fd = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), length) != 0) {
+        close(fd);
+        return -1;
+    }
+    setNoDelay(fd, addr);
+    return fd;
+}
+
+bool sendAll(int fd, const void* data, size_t length) {
+    const char* p = static_cast<const char*>(data);
+    while (length > 0) {
+        ssize_t n = send(fd, p, length, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+// Appends what one recv returns to buffer; false on EOF or error
+bool receiveSome(int fd, vector<char>& buffer) {
+    size_t used = buffer.size();
+    buffer.resize(used + 64 * 1024);
+    ssize_t n = recv(fd, buffer.data() + used, 64 * 1024, 0);
+    buffer.resize(used + max<ssize_t>(n, 0));
+    return n > 0;
+}
+
+// --- Server ---
+
+class KvServer {
+private:
+    unique_ptr<LockEngine> engine;
+    unordered_map<uint64_t, int64_t> table;
+    int listenFd = -1;
+    string boundAddress;
+    atomic<bool> stopping{false};
+    thread acceptThread;
+    mutex connectionsMutex;
+    vector<thread> connectionThreads; // Per slot: the last connection's thread
+    vector<int> openFds;              // -1 when the slot is free
+    atomic<long> served{0};
+
+    // Runs under the engine
+    Response apply(const Request& r) {
+        Response out{STATUS_OK, {}, 0};
+        switch (r.op) {
+        case OP_GET: {
+            auto it = table.find(r.key);
+            if (it == table.end()) out.status = STATUS_MISSING;
+            else out.value = it->second;
+            break;
+        }
+        case OP_SET:
+            out.value = table[r.key] = r.value;
+            break;
+        case OP_ADD:
+            out.value = table[r.key] += r.value;
+            break;
+        default:
+            out.status = STATUS_BAD_REQUEST;
+        }
+        return out;
+    }
+
+    // tid is the connection's slot, which the bakery engines index by
+    void serveConnection(int fd, int tid) {
+        vector<char> in;
+        vector<Response> out;
+        while (receiveSome(fd, in)) {
+            size_t count = in.size() / sizeof(Request);
+            out.resize(count);
+            for (size_t i = 0; i < count; ++i) {
+                Request r;
+                memcpy(&r, in.data() + i * sizeof(Request), sizeof(r));
+                engine->execute(tid, [&] { out[i] = apply(r); });
+            }
+            in.erase(in.begin(), in.begin() + count * sizeof(Request));
+            served += count;
+            if (count > 0 && !sendAll(fd, out.data(), count * sizeof(Response))) break;
+        }
+        lock_guard<mutex> guard(connectionsMutex);
+        close(fd);
+        openFds[tid] = -1;
+    }
+
+    void acceptLoop() {
+        for (;;) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (stopping || (errno != EINTR && errno != ECONNABORTED)) return;
+                continue;
+            }
+            lock_guard<mutex> guard(connectionsMutex);
+            auto slot = find(openFds.begin(), openFds.end(), -1);
+            if (stopping || slot == openFds.end()) {
+                close(fd); // Full: the client sees the connection closed
+                continue;
+            }
+            sockaddr_storage addr;
+            socklen_t length = sizeof(addr);
+            getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &length);
+            setNoDelay(fd, addr);
+            // A free slot's thread has closed its connection and is exiting
+            int tid = int(slot - openFds.begin());
+            if (connectionThreads[tid].joinable()) connectionThreads[tid].join();
+            *slot = fd;
+            connectionThreads[tid] = thread(&KvServer::serveConnection, this, fd, tid);
+        }
+    }
+
+public:
+    KvServer(unique_ptr<LockEngine> e, int maxConnections, long keys)
+        : engine(std::move(e)), connectionThreads(maxConnections), openFds(maxConnections, -1) {
+        table.reserve(keys);
+    }
+
+    ~KvServer() {
+        stop();
+    }
+
+    // Listens on address (for TCP, port 0 picks a free one); false on failure
+    bool start(const string& address) {
+        sockaddr_storage addr;
+        socklen_t length;
+        if (!resolve(address, addr, length)) return false;
+        listenFd = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) return false;
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (addr.ss_family == AF_UNIX) unlink(address.c_str());
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), length) != 0 || listen(listenFd, 128) != 0) {
+            close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        boundAddress = address;
+        if (addr.ss_family == AF_INET) {
+            sockaddr_in bound;
+            socklen_t boundLength = sizeof(bound);
+            getsockname(listenFd, reinterpret_cast<sockaddr*>(&bound), &boundLength);
+            boundAddress = address.substr(0, address.rfind(':') + 1) + to_string(ntohs(bound.sin_port));
+        }
+        acceptThread = thread(&KvServer::acceptLoop, this);
+        return true;
+    }
+
+    // Stops accepting, closes every connection and waits for their threads
+    void stop() {
+        if (listenFd < 0) return;
+        stopping = true;
+        shutdown(listenFd, SHUT_RDWR);
+        acceptThread.join();
+        close(listenFd);
+        listenFd = -1;
+        {
+            lock_guard<mutex> guard(connectionsMutex);
+            for (int fd : openFds) {
+                if (fd >= 0) shutdown(fd, SHUT_RDWR);
+            }
+        }
+        for (auto& t : connectionThreads) {
+            if (t.joinable()) t.join();
+        }
+        if (boundAddress.find('/') != string::npos) unlink(boundAddress.c_str());
+    }
+
+    const string& address() const { return boundAddress; }
+    long requestsServed() const { return served.load(); }
+
+    // Only once stopped
+    int64_t sum() const {
+        int64_t total = 0;
+        for (auto& kv : table) total += kv.second;
+        return total;
+    }
+};
+
+// --- Load generator ---
+
+// Zipfian ranks in [0, n), after Gray et al., "Quickly generating
+// billion-record synthetic databases"; rank 0 is the hottest
+class ZipfianGenerator {
+private:
+    long n;
+    double theta, alpha, zetaN, eta, half;
+    uniform_real_distribution<double> uniform{0.0, 1.0};
+
+    static double zeta(long n, double theta) {
+        double sum = 0;
+        for (long i = 1; i <= n; ++i) sum += 1.0 / pow((double)i, theta);
+        return sum;
+    }
+
+public:
+    ZipfianGenerator(long n, double theta) : n(max(n, 2L)), theta(min(theta, 0.999)) {
+        alpha = 1.0 / (1.0 - this->theta);
+        zetaN = zeta(this->n, this->theta);
+        eta = (1.0 - pow(2.0 / this->n, 1.0 - this->theta)) / (1.0 - zeta(2, this->theta) / zetaN);
+        half = 1.0 + pow(0.5, this->theta);
+    }
+
+    template <typename Rng>
+    long next(Rng& rng) {
+        double u = uniform(rng);
+        double uz = u * zetaN;
+        if (uz < 1.0) return 0;
+        if (uz < half) return 1;
+        return min(n - 1, (long)(n * pow(eta * u - eta + 1.0, alpha)));
+    }
+};
+
+struct LoadOptions {
+    int connections = DEFAULT_CONNECTIONS;
+    int pipeline = DEFAULT_PIPELINE;
+    milliseconds length = SELF_CHECK_LENGTH;
+    double theta = DEFAULT_THETA;
+    long keys = DEFAULT_KEYS;
+};
+
+struct LoadResult {
+    long requests = 0;
+    long adds = 0;       // Acknowledged ADD 1s
+    long errors = 0;     // Failed connections and bad responses
+    vector<uint64_t> latenciesNs;
+};
+
+// Each connection keeps `pipeline` requests outstanding: every batch of
+// responses read is answered with one write of as many new requests
+LoadResult runLoad(const string& address, const LoadOptions& options) {
+    ZipfianGenerator zipf(options.keys, options.theta);
+    atomic<bool> stop{false};
+    vector<LoadResult> results(options.connections);
+    vector<thread> threads;
+    for (int c = 0; c < options.connections; ++c) {
+        threads.emplace_back([&, c] {
+            LoadResult& r = results[c];
+            int fd = connectTo(address);
+            if (fd < 0) {
+                r.errors++;
+                return;
+            }
+            mt19937_64 rng(c + 1);
+            ZipfianGenerator keys = zipf;
+            bernoulli_distribution isGet(GET_RATIO);
+            deque<pair<uint64_t, uint8_t>> outstanding; // Send time and op
+            vector<Request> out;
+            vector<char> in;
+            bool ok = true;
+            while (ok && (!stop.load(memory_order_relaxed) || !outstanding.empty())) {
+                out.clear();
+                while (!stop.load(memory_order_relaxed) && outstanding.size() < (size_t)options.pipeline) {
+                    Request q{isGet(rng) ? OP_GET : OP_ADD, {}, (uint64_t)keys.next(rng), 1};
+                    out.push_back(q);
+                    outstanding.emplace_back(lockstats::nowNs(), q.op);
+                }
+                if (!out.empty() && !sendAll(fd, out.data(), out.size() * sizeof(Request))) break;
+                if (outstanding.empty()) break;
+                ok = receiveSome(fd, in);
+                size_t count = in.size() / sizeof(Response);
+                uint64_t now = lockstats::nowNs();
+                for (size_t i = 0; i < count; ++i) {
+                    Response s;
+                    memcpy(&s, in.data() + i * sizeof(Response), sizeof(s));
+                    auto [sentNs, op] = outstanding.front();
+                    outstanding.pop_front();
+                    r.latenciesNs.push_back(now - sentNs);
+                    r.requests++;
+                    if (op == OP_ADD && s.status == STATUS_OK) r.adds++;
+                    else if (s.status != STATUS_OK && !(op == OP_GET && s.status == STATUS_MISSING)) r.errors++;
+                }
+                in.erase(in.begin(), in.begin() + count * sizeof(Response));
+            }
+            if (!outstanding.empty()) r.errors++;
+            close(fd);
+        });
+    }
+    this_thread::sleep_for(options.length);
+    stop = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    LoadResult total;
+    for (auto& r : results) {
+        total.requests += r.requests;
+        total.adds += r.adds;
+        total.errors += r.errors;
+        total.latenciesNs.insert(total.latenciesNs.end(), r.latenciesNs.begin(), r.latenciesNs.end());
+    }
+    sort(total.latenciesNs.begin(), total.latenciesNs.end());
+    return total;
+}
+
+double percentileUs(const vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    return sorted[min(sorted.size() - 1, (size_t)(sorted.size() * p))] / 1000.0;
+}
+
+void report(const string& engine, const string& transport, const LoadOptions& options, const LoadResult& r) {
+    cout << "Engine: " << engine << ", Transport: " << transport
+         << ", Connections: " << options.connections << ", Pipeline: " << options.pipeline
+         << ", Throughput: " << (long)(r.requests * 1000.0 / options.length.count()) << " req/sec"
+         << fixed << setprecision(1)
+         << ", p50: " << percentileUs(r.latenciesNs, 0.50) << " us"
+         << ", p99: " << percentileUs(r.latenciesNs, 0.99) << " us"
+         << ", p99.9: " << percentileUs(r.latenciesNs, 0.999) << " us" << endl;
+}
+
+// One in-process server and load run; checks the table adds up
+bool selfCheck(const string& engineName, const string& address, const string& transport) {
+    LoadOptions options;
+    KvServer server(makeEngine(engineName, options.connections), options.connections, options.keys);
+    if (!server.start(address)) {
+        cout << "Error: cannot listen on " << address << endl;
+        return false;
+    }
+    LoadResult r = runLoad(server.address(), options);
+    server.stop();
+    report(engineName, transport, options, r);
+    if (r.errors != 0 || r.requests == 0 || server.sum() != r.adds || server.requestsServed() != r.requests) {
+        cout << "Error: " << r.errors << " errors, " << r.adds << " adds acknowledged, table sums to "
+             << server.sum() << ", " << server.requestsServed() << " of " << r.requests << " requests served" << endl;
+        return false;
+    }
+    return true;
+}
+
+int serve(const string& address, const string& engineName, int maxConnections) {
+    auto engine = makeEngine(engineName, maxConnections);
+    if (!engine) {
+        cerr << "Error: unknown engine " << engineName << endl;
+        return 1;
+    }
+    KvServer server(std::move(engine), maxConnections, DEFAULT_KEYS);
+    if (!server.start(address)) {
+        cerr << "Error: cannot listen on " << address << endl;
+        return 1;
+    }
+    cout << "Serving on " << server.address() << " with " << engineName << ", up to "
+         << maxConnections << " connections" << endl;
+    for (;;) {
+        this_thread::sleep_for(seconds(3600));
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 3 && !strcmp(argv[1], "serve")) {
+        string engine = argc > 3 ? argv[3] : "mutex";
+        int maxConnections = argc > 4 ? atoi(argv[4]) : DEFAULT_MAX_CONNECTIONS;
+        return serve(argv[2], engine, max(maxConnections, 1));
+    }
+    if (argc >= 3 && !strcmp(argv[1], "load")) {
+        LoadOptions options;
+        if (argc > 3) options.connections = max(atoi(argv[3]), 1);
+        if (argc > 4) options.pipeline = max(atoi(argv[4]), 1);
+        if (argc > 5) options.length = milliseconds((long)(atof(argv[5]) * 1000));
+        if (argc > 6) options.theta = atof(argv[6]);
+        if (argc > 7) options.keys = max(atol(argv[7]), 2L);
+        LoadResult r = runLoad(argv[2], options);
+        report("remote", argv[2], options, r);
+        if (r.errors != 0) {
+            cerr << "Error: " << r.errors << " failed connections or bad responses" << endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (argc != 1) {
+        cerr << "Usage: " << argv[0] << " [serve ADDRESS [engine] [maxConnections] |"
+             << " load ADDRESS [connections] [pipeline] [seconds] [theta] [keys]]" << endl;
+        return 1;
+    }
+
+    bool ok = true;
+    string socketPath = "/tmp/kvbench_" + to_string(getpid()) + ".sock";
+    for (const char* engine : KV_ENGINES) {
+        ok = selfCheck(engine, socketPath, "unix") && ok;
+    }
+    ok = selfCheck("mutex", "127.0.0.1:0", "tcp") && ok;
+    if (ok) {
+        cout << "Correctness test passed: every acknowledged update is in the table" << endl;
+        return 0;
+    }
+    return 1;
+}
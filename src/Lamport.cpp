@@ -8,6 +8,9 @@
 #include <vector>
 #include <iomanip> // For std::setw
 
+#include "Calibration.h" // Host-calibrated spin thresholds for waiting
+#include "LockStats.h" // Live counters for the lock "top" viewer
+
 // --- Configuration ---
 const int NUM_THREADS = 8;           // Number of threads to run in parallel
 const int ITERATIONS_PER_THREAD = 10000; // Number of times each thread enters the critical section
@@ -26,9 +29,16 @@ std::atomic<long long> shared_counter(0);           // Counter incremented in th
 std::atomic<int> inside_critical_section_count(0); // Counter to check mutual exclusion directly
 std::atomic<bool> mutual_exclusion_violated(false); // Flag set if violation detected
 
+// --- Live Statistics ---
+// Only the lock holder writes it, so the seqlock has a single writer
+lockstats::StatsWriter bakery_stats("bakery", "Lamport.cpp global");
+
 // --- Lamport's Bakery Lock Implementation ---
 // --- Lamport's Bakery Lock Implementation ---
 void lock(int thread_id) { // The ID of the current thread
+    uint64_t wait_start = lockstats::nowNs();
+    bool contended = false;
+
     // 1. Indicate intention to choose a number
     choosing[thread_id].store(true, std::memory_order_seq_cst);
 
@@ -52,23 +62,28 @@ void lock(int thread_id) { // The ID of the current thread
         if (thread_id == j) continue;
 
         // Wait while thread j is choosing its number
+        SpinWait choosing_wait(hostCalibration().spinBeforeYield);
         while (choosing[j].load(std::memory_order_seq_cst)) {
-            std::this_thread::yield();
+            contended = true;
+            choosing_wait.once();
         }
 
         // Wait while thread j has a number and has higher priority:
         // Priority: (number[j], j) < (number[thread_id], thread_id)
         int num_j;
+        SpinWait number_wait(hostCalibration().spinBeforeYield);
         while ( (num_j = number[j].load(std::memory_order_seq_cst)) != 0 &&
                 ( (num_j < number[thread_id].load(std::memory_order_seq_cst)) ||
                   (num_j == number[thread_id].load(std::memory_order_seq_cst) && j < thread_id)
                 )
               )
         {
-            std::this_thread::yield();
+            contended = true;
+            number_wait.once();
         }
     }
     // --- At this point, thread_id has acquired the lock ---
+    bakery_stats.recordAcquire(contended, lockstats::nowNs() - wait_start);
 }
 
 void unlock(int thread_id) {
@@ -126,6 +141,10 @@ int main() {
      if (ENABLE_WORK_SIMULATION) {
         std::cout << "Work Delay per CS: " << WORK_DELAY.count() << " us" << std::endl;
      }
+    // Calibrate spin thresholds once, before any thread waits
+    const Calibration& calib = hostCalibration();
+    std::cout << "Spin Before Yield: " << calib.spinBeforeYield << " pauses ("
+              << calib.cpus << " CPUs, handoff " << calib.handoffNs << " ns)" << std::endl;
     std::cout << "---------------------------------------------" << std::endl;
 
 
@@ -3,64 +3,22 @@
 #include <thread>
 #include <atomic>
 #include <chrono>
-#include <algorithm>
+#include <cstring>
+
+#include "BakeryLock.h"
+#include "Placement.h"
 
 using namespace std;
 using namespace std::chrono;
 
-class BakeryLock {
-private:
-    vector<atomic<bool>> choosing;
-    vector<atomic<int>> ticket;
-    int threadCount;
-
-public:
-    BakeryLock(int n) : threadCount(n), choosing(n), ticket(n) {
-        for (int i = 0; i < n; ++i) {
-            choosing[i] = false;
-            ticket[i] = 0;
-        }
-    }
-
-    void lock(int id) {
-        choosing[id] = true;
-        
-        // Find max ticket and add 1
-        int max_ticket = 0;
-        for (int i = 0; i < threadCount; ++i) {
-            int current = ticket[i];
-            max_ticket = max(max_ticket, current);
-        }
-        ticket[id] = max_ticket + 1;
-        choosing[id] = false;
-
-        // Wait until it's our turn
-        for (int i = 0; i < threadCount; ++i) {
-            if (i == id) continue;
-            
-            // Wait until thread i finishes choosing
-            while (choosing[i]) {
-                this_thread::yield();
-            }
-            
-            // Wait until our ticket is the smallest
-            while (ticket[i] != 0 && 
-                  (ticket[i] < ticket[id] || 
-                  (ticket[i] == ticket[id] && i < id))) {
-                this_thread::yield();
-            }
-        }
-    }
-
-    void unlock(int id) {
-        ticket[id] = 0;
-    }
-};
-
 // Shared counter for testing
 atomic<int> sharedCounter(0);
 const int OPERATIONS_PER_THREAD = 100000;
 
+// Set by --matrix: place threads from a CoreLatency matrix
+LatencyMatrix placementMatrix;
+bool usePlacement = false;
+
 void threadFunction(BakeryLock& lock, int id) {
     for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
         lock.lock(id);
@@ -94,12 +52,21 @@ void testCorrectness(int threadCount) {
 void testPerformance(int threadCount) {
     BakeryLock lock(threadCount);
     sharedCounter = 0;
+    Placement placement;
+    if (usePlacement) {
+        placement = planPlacement(placementMatrix, threadCount, false);
+    }
     
     auto start = high_resolution_clock::now();
     
     vector<thread> threads;
     for (int i = 0; i < threadCount; ++i) {
-        threads.emplace_back(threadFunction, ref(lock), i);
+        threads.emplace_back([&lock, &placement, i] {
+            if (!placement.threadCpus.empty()) {
+                pinCurrentThread(placement.threadCpus[i]);
+            }
+            threadFunction(lock, i);
+        });
     }
     
     for (auto& t : threads) {
@@ -114,7 +81,19 @@ void testPerformance(int threadCount) {
          << ", Counter: " << sharedCounter << endl;
 }
 
-int main() {
+int main(int argc, char** argv) {
+    if (argc == 3 && !strcmp(argv[1], "--matrix")) {
+        usePlacement = loadLatencyMatrix(argv[2], "bakery", placementMatrix) ||
+                       loadLatencyMatrix(argv[2], "pingpong", placementMatrix);
+        if (!usePlacement) {
+            cerr << "Error: no usable latency matrix in " << argv[2] << endl;
+            return 1;
+        }
+    } else if (argc != 1) {
+        cerr << "Usage: " << argv[0] << " [--matrix file.csv]" << endl;
+        return 1;
+    }
+
     // Test correctness with different thread counts
     for (int i = 1; i <= 8; i *= 2) {
         testCorrectness(i);
@@ -0,0 +1,143 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cmath>
+
+#include "BakeryLock.h"
+#include "FairShareBakeryLock.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Tenants with different thread counts and weights compete for one lock
+// for a fixed time. Reports each tenant's share of lock time against its
+// configured share under BakeryLock and FairShareBakeryLock, then the
+// fair-share lock's throughput against BakeryLock's with one tenant per
+// thread and equal weights.
+
+// Test parameters
+const int THREADS = 8;
+const int CS_NS = 2000;             // Busy critical section
+const milliseconds RUN_LENGTH(300);
+const double SHARE_TOLERANCE = 0.1; // Largest share error for the fair-share lock
+
+struct Scenario {
+    const char* name;
+    int tenantOf[THREADS];
+    double weights[THREADS]; // Per tenant
+    int tenantCount;
+};
+
+const Scenario SCENARIOS[] = {
+    {"noisy tenant, equal weights", {0, 0, 0, 0, 0, 0, 1, 2}, {1, 1, 1}, 3},
+    {"weights 4:2:1, equal threads", {0, 0, 1, 1, 2, 2, 2, 2}, {4, 2, 1}, 3},
+};
+
+long inside = 0;
+long violations = 0;
+
+void spinFor(uint64_t ns) {
+    uint64_t until = lockstats::nowNs() + ns;
+    while (lockstats::nowNs() < until) {
+    }
+}
+
+struct RunResult {
+    long ops = 0;
+    vector<uint64_t> heldNs; // Per tenant
+};
+
+// Lock has lock(id) and unlock(id); the lock is the only synchronisation
+// for the per-tenant hold times
+template <typename Lock>
+RunResult runThreads(Lock& lock, const int* tenantOf, int tenantCount, uint64_t csNs) {
+    atomic<bool> stop(false);
+    atomic<long> ops(0);
+    RunResult r;
+    r.heldNs.assign(tenantCount, 0);
+    vector<thread> threads;
+    for (int id = 0; id < THREADS; ++id) {
+        threads.emplace_back([&, id] {
+            long done = 0;
+            while (!stop.load(memory_order_relaxed)) {
+                lock.lock(id);
+                uint64_t begin = lockstats::nowNs();
+                if (++inside != 1) violations++;
+                spinFor(csNs);
+                inside--;
+                r.heldNs[tenantOf[id]] += lockstats::nowNs() - begin;
+                lock.unlock(id);
+                done++;
+            }
+            ops += done;
+        });
+    }
+    this_thread::sleep_for(RUN_LENGTH);
+    stop = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    r.ops = ops;
+    return r;
+}
+
+// Prints shares; returns the largest distance from the configured share
+double reportShares(const char* engine, const Scenario& s, const RunResult& r) {
+    double totalWeight = 0, totalHeld = 0;
+    for (int t = 0; t < s.tenantCount; ++t) {
+        totalWeight += s.weights[t];
+        totalHeld += r.heldNs[t];
+    }
+    double worst = 0;
+    cout << "Scenario: " << s.name << ", Engine: " << engine << ", Shares:" << fixed << setprecision(2);
+    for (int t = 0; t < s.tenantCount; ++t) {
+        double target = s.weights[t] / totalWeight;
+        double achieved = totalHeld > 0 ? r.heldNs[t] / totalHeld : 0;
+        worst = max(worst, fabs(achieved - target));
+        cout << " " << achieved << " (want " << target << ")";
+    }
+    cout << endl;
+    return worst;
+}
+
+int main() {
+    bool ok = true;
+    for (const Scenario& s : SCENARIOS) {
+        BakeryLock plain(THREADS);
+        reportShares("BakeryLock", s, runThreads(plain, s.tenantOf, s.tenantCount, CS_NS));
+
+        FairShareBakeryLock fair(THREADS);
+        for (int id = 0; id < THREADS; ++id) fair.setTenant(id, s.tenantOf[id]);
+        for (int t = 0; t < s.tenantCount; ++t) fair.setWeight(t, s.weights[t]);
+        double worst = reportShares("FairShareBakeryLock", s, runThreads(fair, s.tenantOf, s.tenantCount, CS_NS));
+        if (worst > SHARE_TOLERANCE) {
+            cout << "Error: a tenant's share is " << worst << " from its weight" << endl;
+            ok = false;
+        }
+    }
+
+    // Overhead: a short critical section, one tenant per thread
+    int ownTenant[THREADS];
+    for (int id = 0; id < THREADS; ++id) ownTenant[id] = id;
+    BakeryLock plain(THREADS);
+    long plainOps = runThreads(plain, ownTenant, THREADS, 0).ops;
+    FairShareBakeryLock fair(THREADS);
+    long fairOps = runThreads(fair, ownTenant, THREADS, 0).ops;
+    cout << "Overhead: BakeryLock " << plainOps * 1000 / RUN_LENGTH.count() << " ops/sec"
+         << ", FairShareBakeryLock " << fairOps * 1000 / RUN_LENGTH.count() << " ops/sec"
+         << ", Ratio: " << setprecision(2) << double(fairOps) / max(plainOps, 1L) << endl;
+
+    if (violations != 0) {
+        cout << "Error: " << violations << " entries found the lock held" << endl;
+        ok = false;
+    }
+    if (ok) {
+        cout << "Correctness test passed: mutual exclusion held and shares followed weights" << endl;
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,163 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+
+#include "BakeryLock.h"
+#include "GroupBakeryLock.h"
+#include "TestSupport.h"
+
+using namespace std;
+using namespace std::chrono;
+using testsupport::waitUntil;
+
+// Group mutual exclusion: threads enter for a session, and only threads of
+// the same session may be inside together. Checks exclusion between
+// sessions, that one session's threads do overlap, and first-come
+// first-served order between sessions; then compares throughput with
+// BakeryLock, which serialises every thread, over session counts and mixes.
+// The critical section sleeps, as a reader waiting on I/O would.
+
+// Test parameters
+const int THREADS = 8;
+const int OPERATIONS_PER_THREAD = 300;
+const microseconds CS_LENGTH(20);
+const int SESSION_COUNTS[] = {1, 2, 4, 8};
+const double SKEWED_SHARE = 0.9;   // Of entries in session 0, in the skewed mix
+
+const int MAX_SESSIONS = 8;
+atomic<int> inside[MAX_SESSIONS];
+atomic<int> totalInside(0);
+atomic<int> maxTogether(0);
+atomic<long> violations(0);
+
+void enterSection(int session) {
+    inside[session]++;
+    for (int s = 0; s < MAX_SESSIONS; ++s) {
+        if (s != session && inside[s] != 0) violations++;
+    }
+    int together = ++totalInside;
+    int seen = maxTogether;
+    while (together > seen && !maxTogether.compare_exchange_weak(seen, together)) {
+    }
+    this_thread::sleep_for(CS_LENGTH);
+    totalInside--;
+    inside[session]--;
+}
+
+// Lock has lock(id, session) and unlock(id)
+template <typename Lock>
+long runThreads(Lock& lock, int sessions, bool skewed) {
+    auto start = high_resolution_clock::now();
+    vector<thread> threads;
+    for (int id = 0; id < THREADS; ++id) {
+        threads.emplace_back([&, id] {
+            mt19937 rng(id + 1);
+            uniform_int_distribution<int> any(0, sessions - 1);
+            bernoulli_distribution hot(SKEWED_SHARE);
+            for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+                int session = skewed && hot(rng) ? 0 : any(rng);
+                lock.lock(id, session);
+                enterSection(session);
+                lock.unlock(id);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    return duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+}
+
+// BakeryLock with the session ignored
+struct PlainBakery {
+    BakeryLock inner{THREADS};
+    void lock(int id, int) { inner.lock(id); }
+    void unlock(int id) { inner.unlock(id); }
+};
+
+// A in session 0 holds the lock; B arrives for session 1, then C for
+// session 0. C may not pass B, though it could share with A. Without B,
+// C enters beside A.
+bool testOrder() {
+    bool ok = true;
+    for (bool withB : {true, false}) {
+        GroupBakeryLock lock(3);
+        atomic<int> next(0);
+        int orderA = -1, orderB = -1, orderC = -1;
+        atomic<bool> cInsideWithA(false);
+        atomic<bool> aLeaving(false);
+
+        lock.lock(0, 0);
+        orderA = next++;
+        thread b, c;
+        if (withB) {
+            b = thread([&] {
+                lock.lock(1, 1);
+                orderB = next++;
+                lock.unlock(1);
+            });
+            waitUntil([&] { return lock.hasTicket(1); });
+        }
+        c = thread([&] {
+            lock.lock(2, 0);
+            orderC = next++;
+            cInsideWithA = !aLeaving;
+            lock.unlock(2);
+        });
+        // With B queued, C must take its ticket behind B's and wait; without,
+        // it should come in beside A
+        if (withB) waitUntil([&] { return lock.hasTicket(2); });
+        else waitUntil([&] { return next == 2; });
+        aLeaving = true;
+        lock.unlock(0);
+        if (b.joinable()) b.join();
+        c.join();
+
+        if (withB && !(orderA == 0 && orderB == 1 && orderC == 2)) {
+            cout << "Error: entry order A " << orderA << ", B " << orderB << ", C " << orderC
+                 << "; a later thread of the holding session passed a waiting session" << endl;
+            ok = false;
+        }
+        if (!withB && !cInsideWithA) {
+            cout << "Error: a thread of the holding session waited with nobody else queued" << endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int main() {
+    bool ok = testOrder();
+
+    for (bool skewed : {false, true}) {
+        for (int sessions : SESSION_COUNTS) {
+            PlainBakery plain;
+            long plainUs = runThreads(plain, sessions, skewed);
+
+            GroupBakeryLock group(THREADS);
+            maxTogether = 0;
+            long groupUs = runThreads(group, sessions, skewed);
+
+            long total = (long)THREADS * OPERATIONS_PER_THREAD;
+            cout << "Sessions: " << sessions << ", Mix: " << (skewed ? "skewed" : "uniform")
+                 << ", BakeryLock: " << total * 1000000 / plainUs << " ops/sec"
+                 << ", GroupBakeryLock: " << total * 1000000 / groupUs << " ops/sec"
+                 << ", Speedup: " << fixed << setprecision(2) << double(plainUs) / groupUs
+                 << ", Most inside together: " << maxTogether << endl;
+        }
+    }
+
+    if (violations != 0) {
+        cout << "Error: " << violations << " entries found another session inside" << endl;
+        ok = false;
+    }
+    if (ok) {
+        cout << "Correctness test passed: sessions excluded each other and entered in order" << endl;
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,165 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <semaphore>
+
+#include "KExclusionBakeryLock.h"
+#include "TestSupport.h"
+
+using namespace std;
+using namespace std::chrono;
+using testsupport::waitUntil;
+
+// k-exclusion: at most k threads inside at once. Checks the bound, the try
+// and timeout variants, and first-come first-served entry; then runs
+// threads against KExclusionBakeryLock and std::counting_semaphore for a
+// fixed time and reports throughput and fairness (fewest entries by one
+// thread over most). The critical section sleeps, as a thread holding a
+// pooled connection would.
+//
+// Built as C++20 for std::counting_semaphore.
+
+// Test parameters
+const int THREADS = 8;
+const int SLOT_COUNTS[] = {1, 2, 4};
+const microseconds CS_LENGTH(20);
+const milliseconds RUN_LENGTH(200);
+const milliseconds TIMEOUT(5);
+
+atomic<int> inside(0);
+atomic<int> mostInside(0);
+
+void useSlot() {
+    int now = ++inside;
+    int seen = mostInside;
+    while (now > seen && !mostInside.compare_exchange_weak(seen, now)) {
+    }
+    this_thread::sleep_for(CS_LENGTH);
+    inside--;
+}
+
+struct RunResult {
+    long ops = 0;
+    long minOps = 0;
+    long maxOps = 0;
+};
+
+// acquire(id) / release(id) around each use
+template <typename Acquire, typename Release>
+RunResult runThreads(Acquire acquire, Release release) {
+    atomic<bool> stop(false);
+    vector<long> ops(THREADS, 0);
+    vector<thread> threads;
+    for (int id = 0; id < THREADS; ++id) {
+        threads.emplace_back([&, id] {
+            while (!stop.load(memory_order_relaxed)) {
+                acquire(id);
+                useSlot();
+                release(id);
+                ops[id]++;
+            }
+        });
+    }
+    this_thread::sleep_for(RUN_LENGTH);
+    stop = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    RunResult r;
+    for (long n : ops) r.ops += n;
+    r.minOps = *min_element(ops.begin(), ops.end());
+    r.maxOps = *max_element(ops.begin(), ops.end());
+    return r;
+}
+
+// Two holders fill k = 2; tryLock and tryLockFor must fail, a waiter that
+// arrives before a later thread must enter first, and a freed slot must
+// admit tryLock again.
+bool testTryAndOrder() {
+    bool ok = true;
+    KExclusionBakeryLock lock(5, 2);
+    lock.lock(0);
+    lock.lock(1);
+    if (lock.tryLock(2)) {
+        cout << "Error: tryLock entered with every slot taken" << endl;
+        lock.unlock(2);
+        ok = false;
+    }
+    auto start = steady_clock::now();
+    if (lock.tryLockFor(2, TIMEOUT)) {
+        cout << "Error: tryLockFor entered with every slot taken" << endl;
+        lock.unlock(2);
+        ok = false;
+    } else if (steady_clock::now() - start < TIMEOUT) {
+        cout << "Error: tryLockFor gave up early" << endl;
+        ok = false;
+    }
+
+    atomic<int> next(0);
+    int orderEarly = -1, orderLate = -1;
+    thread early([&] {
+        lock.lock(2);
+        orderEarly = next++;
+        lock.unlock(2);
+    });
+    waitUntil([&] { return lock.hasTicket(2); });
+    thread late([&] {
+        lock.lock(3);
+        orderLate = next++;
+        lock.unlock(3);
+    });
+    waitUntil([&] { return lock.hasTicket(3); });
+    lock.unlock(0);
+    early.join();
+    late.join();
+    if (orderEarly != 0 || orderLate != 1) {
+        cout << "Error: waiters entered out of order" << endl;
+        ok = false;
+    }
+
+    if (!lock.tryLock(4)) {
+        cout << "Error: tryLock failed with a slot free" << endl;
+        ok = false;
+    } else {
+        lock.unlock(4);
+    }
+    lock.unlock(1);
+    return ok;
+}
+
+void report(const char* name, int k, const RunResult& r) {
+    cout << "Slots: " << k << ", Engine: " << name
+         << ", Throughput: " << r.ops * 1000 / RUN_LENGTH.count() << " ops/sec"
+         << ", Fairness: " << fixed << setprecision(2) << (r.maxOps ? double(r.minOps) / r.maxOps : 0)
+         << ", Most inside: " << mostInside << endl;
+}
+
+int main() {
+    bool ok = testTryAndOrder();
+
+    for (int k : SLOT_COUNTS) {
+        KExclusionBakeryLock bakery(THREADS, k);
+        mostInside = 0;
+        RunResult r = runThreads([&](int id) { bakery.lock(id); }, [&](int id) { bakery.unlock(id); });
+        report("KExclusionBakeryLock", k, r);
+        if (mostInside > k) {
+            cout << "Error: " << mostInside << " threads inside with " << k << " slots" << endl;
+            ok = false;
+        }
+
+        counting_semaphore<THREADS> semaphore(k);
+        mostInside = 0;
+        r = runThreads([&](int) { semaphore.acquire(); }, [&](int) { semaphore.release(); });
+        report("counting_semaphore", k, r);
+    }
+
+    if (ok) {
+        cout << "Correctness test passed: at most k inside, in ticket order, try and timeout held" << endl;
+        return 0;
+    }
+    return 1;
+}
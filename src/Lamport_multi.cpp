@@ -0,0 +1,201 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+
+#include "BakeryLock.h"
+#include "MultiBakeryLock.h"
+#include "TestSupport.h"
+
+using namespace std;
+using namespace std::chrono;
+using testsupport::waitUntil;
+
+// Transfers between striped accounts, each needing several stripes at
+// once: one MultiBakeryLock doorway for the whole set, against one
+// BakeryLock per stripe taken in ascending order. Checks that no stripe
+// has two holders, that transfers conserve the total, and that waiting
+// depends only on overlap with earlier tickets. The critical section
+// sleeps, as one waiting on I/O would. Also reports the uncontended cost
+// of taking and releasing a set, one doorway against one per stripe.
+
+// Test parameters
+const int THREADS = 8;
+const int STRIPES = 16;
+const int OPERATIONS_PER_THREAD = 300;
+const microseconds CS_LENGTH(20);
+const int STRIPES_PER_OP[] = {1, 2, 4};
+const long OPENING_BALANCE = 1000;
+const int UNCONTENDED_ROUNDS = 100000;
+
+long balances[STRIPES];
+atomic<int> holders[STRIPES];
+atomic<long> violations(0);
+
+void transfer(const vector<int>& stripes, mt19937& rng) {
+    for (int s : stripes) {
+        if (holders[s]++ != 0) violations++;
+    }
+    // Move a random amount from the first stripe to each of the others
+    uniform_int_distribution<long> amount(0, 10);
+    for (size_t i = 1; i < stripes.size(); ++i) {
+        long a = amount(rng);
+        balances[stripes[0]] -= a;
+        balances[stripes[i]] += a;
+    }
+    this_thread::sleep_for(CS_LENGTH);
+    for (int s : stripes) {
+        holders[s]--;
+    }
+}
+
+// acquire(id, sorted stripes) / release(id, sorted stripes)
+template <typename Acquire, typename Release>
+long runThreads(int perOp, Acquire acquire, Release release) {
+    auto start = high_resolution_clock::now();
+    vector<thread> threads;
+    for (int id = 0; id < THREADS; ++id) {
+        threads.emplace_back([&, id] {
+            mt19937 rng(id + 1);
+            vector<int> all(STRIPES);
+            for (int s = 0; s < STRIPES; ++s) all[s] = s;
+            for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+                shuffle(all.begin(), all.end(), rng);
+                vector<int> stripes(all.begin(), all.begin() + perOp);
+                sort(stripes.begin(), stripes.end());
+                acquire(id, stripes);
+                transfer(stripes, rng);
+                release(id, stripes);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    return duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+}
+
+MultiBakeryLock::ResourceSet setOf(const vector<int>& stripes) {
+    MultiBakeryLock::ResourceSet set = 0;
+    for (int s : stripes) set |= MultiBakeryLock::ResourceSet(1) << s;
+    return set;
+}
+
+// A holds {0, 1}. B asks for {1, 2} and waits on A; C then asks for {2}
+// and must wait on B, though nobody holds 2; D asks for {3} and enters.
+bool testOverlapOrder() {
+    MultiBakeryLock lock(4);
+    atomic<int> next(0);
+    int orderB = -1, orderC = -1;
+    atomic<bool> dEntered(false);
+
+    lock.lock(0, MultiBakeryLock::resources({0, 1}));
+    thread b([&] {
+        lock.lock(1, MultiBakeryLock::resources({1, 2}));
+        orderB = next++;
+        lock.unlock(1);
+    });
+    waitUntil([&] { return lock.hasTicket(1); });
+    thread c([&] {
+        lock.lock(2, MultiBakeryLock::resources({2}));
+        orderC = next++;
+        lock.unlock(2);
+    });
+    thread d([&] {
+        lock.lock(3, MultiBakeryLock::resources({3}));
+        dEntered = true;
+        lock.unlock(3);
+    });
+    d.join(); // Would hang if D waited for A
+    waitUntil([&] { return lock.hasTicket(2); });
+    bool cWaited = next == 0;
+    lock.unlock(0);
+    b.join();
+    c.join();
+
+    bool ok = true;
+    if (!dEntered || !cWaited || orderB != 0 || orderC != 1) {
+        cout << "Error: disjoint entry " << (dEntered ? "ran" : "waited") << ", overlapping later ticket "
+             << (cWaited ? "waited" : "went first") << ", order B " << orderB << ", C " << orderC << endl;
+        ok = false;
+    }
+    return ok;
+}
+
+// Resources outside 0..MAX_RESOURCES-1 are rejected rather than shifted
+bool testResourceBounds() {
+    for (int r : {-1, MultiBakeryLock::MAX_RESOURCES}) {
+        try {
+            MultiBakeryLock::resources({0, r});
+            cout << "Error: resource " << r << " accepted" << endl;
+            return false;
+        } catch (const out_of_range&) {
+        }
+    }
+    return true;
+}
+
+// Nanoseconds per acquire and release of the same set, with no other thread
+template <typename Acquire, typename Release>
+double uncontendedNs(const vector<int>& stripes, Acquire acquire, Release release) {
+    uint64_t start = lockstats::nowNs();
+    for (int i = 0; i < UNCONTENDED_ROUNDS; ++i) {
+        acquire(0, stripes);
+        release(0, stripes);
+    }
+    return double(lockstats::nowNs() - start) / UNCONTENDED_ROUNDS;
+}
+
+int main() {
+    bool ok = testOverlapOrder();
+    ok = testResourceBounds() && ok;
+
+    for (int s = 0; s < STRIPES; ++s) balances[s] = OPENING_BALANCE;
+    for (int perOp : STRIPES_PER_OP) {
+        vector<unique_ptr<BakeryLock>> stripeLocks;
+        for (int s = 0; s < STRIPES; ++s) stripeLocks.emplace_back(new BakeryLock(THREADS));
+        auto orderedAcquire = [&](int id, const vector<int>& stripes) {
+            for (int s : stripes) stripeLocks[s]->lock(id);
+        };
+        auto orderedRelease = [&](int id, const vector<int>& stripes) {
+            for (auto it = stripes.rbegin(); it != stripes.rend(); ++it) stripeLocks[*it]->unlock(id);
+        };
+        long orderedUs = runThreads(perOp, orderedAcquire, orderedRelease);
+
+        MultiBakeryLock multi(THREADS);
+        auto multiAcquire = [&](int id, const vector<int>& stripes) { multi.lock(id, setOf(stripes)); };
+        auto multiRelease = [&](int id, const vector<int>&) { multi.unlock(id); };
+        long multiUs = runThreads(perOp, multiAcquire, multiRelease);
+
+        vector<int> firstStripes(perOp);
+        for (int s = 0; s < perOp; ++s) firstStripes[s] = s;
+        double orderedNs = uncontendedNs(firstStripes, orderedAcquire, orderedRelease);
+        double multiNs = uncontendedNs(firstStripes, multiAcquire, multiRelease);
+
+        long total = (long)THREADS * OPERATIONS_PER_THREAD;
+        cout << "Stripes per op: " << perOp << " of " << STRIPES
+             << ", Ordered BakeryLocks: " << total * 1000000 / orderedUs << " ops/sec"
+             << ", MultiBakeryLock: " << total * 1000000 / multiUs << " ops/sec"
+             << ", Speedup: " << fixed << setprecision(2) << double(orderedUs) / multiUs
+             << setprecision(1) << ", Uncontended: " << orderedNs << " ns vs " << multiNs << " ns" << endl;
+    }
+
+    long sum = 0;
+    for (long b : balances) sum += b;
+    if (violations != 0 || sum != OPENING_BALANCE * STRIPES) {
+        cout << "Error: " << violations << " stripes had two holders, total " << sum
+             << " instead of " << OPENING_BALANCE * STRIPES << endl;
+        ok = false;
+    }
+    if (ok) {
+        cout << "Correctness test passed: stripes held alone, totals conserved, waits only on overlap" << endl;
+        return 0;
+    }
+    return 1;
+}
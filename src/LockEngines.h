@@ -0,0 +1,187 @@
+#pragma once
+
+// Uniform adapter over the lock engines, for drivers (replay, tuning, ...)
+// that run the same critical sections against each engine in turn.
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "BakeryLock.h"
+#include "Calibration.h"
+#include "DelegationLock.h"
+#include "LockStats.h"
+
+class LockEngine {
+public:
+    virtual ~LockEngine() {}
+    virtual const char* name() const = 0;
+
+    // Runs cs with mutual exclusion on behalf of thread tid (0 <= tid < threads).
+    virtual void execute(int tid, const std::function<void()>& cs) = 0;
+
+    // Runs a read-only cs. Engines without a shared mode run it exclusively.
+    virtual void executeShared(int tid, const std::function<void()>& cs) { execute(tid, cs); }
+};
+
+class MutexEngine : public LockEngine {
+private:
+    std::mutex m;
+
+public:
+    const char* name() const override { return "mutex"; }
+
+    void execute(int, const std::function<void()>& cs) override {
+        std::lock_guard<std::mutex> guard(m);
+        cs();
+    }
+};
+
+class RwLockEngine : public LockEngine {
+private:
+    std::shared_mutex m;
+
+public:
+    const char* name() const override { return "rwlock"; }
+
+    void execute(int, const std::function<void()>& cs) override {
+        std::unique_lock<std::shared_mutex> guard(m);
+        cs();
+    }
+
+    void executeShared(int, const std::function<void()>& cs) override {
+        std::shared_lock<std::shared_mutex> guard(m);
+        cs();
+    }
+};
+
+class BakeryEngine : public LockEngine {
+private:
+    BakeryLock lock;
+
+public:
+    BakeryEngine(int threads, const Calibration& c = hostCalibration()) : lock(threads, c) {}
+
+    const char* name() const override { return "bakery"; }
+
+    void execute(int tid, const std::function<void()>& cs) override {
+        lock.lock(tid);
+        cs();
+        lock.unlock(tid);
+    }
+};
+
+// The global lock of Lamport.cpp as an engine, with one slot per thread and
+// every access sequentially consistent. tid is in 0..threads-1.
+class LamportEngine : public LockEngine {
+private:
+    std::vector<std::atomic<bool>> choosing;
+    std::vector<std::atomic<int>> number;
+    int threadCount;
+    lockstats::StatsWriter stats;
+    Calibration calib;
+
+public:
+    LamportEngine(int threads, const Calibration& c = hostCalibration())
+        : choosing(threads), number(threads), threadCount(threads), stats("bakery", "Lamport global"), calib(c) {
+        for (int i = 0; i < threads; ++i) {
+            choosing[i] = false;
+            number[i] = 0;
+        }
+    }
+
+    const char* name() const override { return "lamport"; }
+
+    void execute(int tid, const std::function<void()>& cs) override {
+        uint64_t start = lockstats::nowNs();
+        bool contended = false;
+        choosing[tid].store(true, std::memory_order_seq_cst);
+        int maxNumber = 0;
+        for (int i = 0; i < threadCount; ++i) {
+            maxNumber = std::max(maxNumber, number[i].load(std::memory_order_seq_cst));
+        }
+        number[tid].store(maxNumber + 1, std::memory_order_seq_cst);
+        choosing[tid].store(false, std::memory_order_seq_cst);
+
+        int mine = maxNumber + 1;
+        for (int j = 0; j < threadCount; ++j) {
+            if (j == tid) continue;
+            SpinWait choosingWait(calib.spinBeforeYield, calib);
+            while (choosing[j].load(std::memory_order_seq_cst)) {
+                contended = true;
+                choosingWait.once();
+            }
+            int theirs;
+            SpinWait numberWait(calib.spinBeforeYield, calib);
+            while ((theirs = number[j].load(std::memory_order_seq_cst)) != 0 &&
+                   (theirs < mine || (theirs == mine && j < tid))) {
+                contended = true;
+                numberWait.once();
+            }
+        }
+        stats.recordAcquire(contended, lockstats::nowNs() - start);
+        cs();
+        number[tid].store(0, std::memory_order_seq_cst);
+    }
+};
+
+class DelegationEngine : public LockEngine {
+private:
+    DelegationLock lock;
+
+public:
+    DelegationEngine(const Calibration& c = hostCalibration()) : lock(-1, c) {}
+
+    const char* name() const override { return "delegation"; }
+
+    void execute(int, const std::function<void()>& cs) override {
+        // cs outlives the request because we wait for it
+        lock.async([&cs] { cs(); }).wait();
+    }
+};
+
+const char* const ENGINE_NAMES[] = {"mutex", "bakery", "delegation"};
+
+// Wait policies for engines that spin: host-calibrated, or no spinning at all
+const char* const SPIN_POLICIES[] = {"calibrated", "nospin"};
+
+// Returns nullptr for an unknown engine or spin policy.
+inline std::unique_ptr<LockEngine> makeEngine(const std::string& name, int threads,
+                                              const std::string& spin = "calibrated") {
+    if (spin != "calibrated" && spin != "nospin") return nullptr;
+    Calibration c = spin == "nospin" ? noSpinCalibration() : hostCalibration();
+    if (name == "mutex") return std::unique_ptr<LockEngine>(new MutexEngine());
+    if (name == "rwlock") return std::unique_ptr<LockEngine>(new RwLockEngine());
+    if (name == "bakery") return std::unique_ptr<LockEngine>(new BakeryEngine(threads, c));
+    if (name == "delegation") return std::unique_ptr<LockEngine>(new DelegationEngine(c));
+    if (name == "lamport") return std::unique_ptr<LockEngine>(new LamportEngine(threads, c));
+    return nullptr;
+}
+
+// Reads a key=value recommendation file (as written by Autotune).
+inline std::map<std::string, std::string> loadRecommendation(const std::string& path) {
+    std::map<std::string, std::string> values;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t eq = line.find('=');
+        if (line.empty() || line[0] == '#' || eq == std::string::npos) continue;
+        values[line.substr(0, eq)] = line.substr(eq + 1);
+    }
+    return values;
+}
+
+// Builds the engine recommended in `path`, falling back to std::mutex when the
+// file is missing or names something this build does not know.
+inline std::unique_ptr<LockEngine> makeRecommendedEngine(const std::string& path, int threads) {
+    auto rec = loadRecommendation(path);
+    auto engine = makeEngine(rec["engine"], threads, rec.count("spin") ? rec["spin"] : "calibrated");
+    return engine ? std::move(engine) : makeEngine("mutex", threads);
+}
@@ -0,0 +1,209 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "LockEngines.h"
+#include "LockTrace.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Records critical-section traces from a run of one engine and replays them,
+// with the original arrival times and durations, against every engine.
+//
+// Usage:
+//   LockReplay                                       record + replay self-check
+//   LockReplay record FILE [engine] [threads] [ops]  record a synthetic workload
+//   LockReplay replay FILE [engine...]               replay against engines
+
+const int DEFAULT_THREADS = 4;
+const int DEFAULT_OPERATIONS = 2000;
+const int MAX_THINK_NS = 20000;
+const int MAX_CS_NS = 3000;
+
+void spinFor(uint64_t ns) {
+    uint64_t until = lockstats::nowNs() + ns;
+    while (lockstats::nowNs() < until) {
+    }
+}
+
+// Open-loop synthetic workload: random think time, then a random-length critical section
+void recordWorker(LockEngine& engine, int id, int operations, long& counter) {
+    mt19937 rng(id + 1);
+    uniform_int_distribution<int> think(0, MAX_THINK_NS);
+    uniform_int_distribution<int> cs(0, MAX_CS_NS);
+    for (int i = 0; i < operations; ++i) {
+        spinFor(think(rng));
+        int length = cs(rng);
+        engine.execute(id, [&counter, length] {
+            counter++;
+            spinFor(length);
+        });
+    }
+}
+
+bool recordTrace(const char* path, const string& engineName, int threadCount, int operations) {
+    auto engine = makeEngine(engineName, threadCount);
+    if (!engine) {
+        cerr << "Error: unknown engine " << engineName << endl;
+        return false;
+    }
+    locktrace::TraceRecorder recorder(threadCount, operations);
+    locktrace::RecordingEngine recording(*engine, recorder);
+    long counter = 0;
+
+    auto start = high_resolution_clock::now();
+    vector<thread> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back(recordWorker, ref(recording), i, operations, ref(counter));
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto duration = duration_cast<milliseconds>(high_resolution_clock::now() - start).count();
+
+    if (!recorder.write(path)) {
+        cerr << "Error: could not write trace " << path << endl;
+        return false;
+    }
+    cout << "Recorded " << counter << " critical sections from " << engineName
+         << " (" << threadCount << " threads, " << duration << " ms) into " << path << endl;
+    return true;
+}
+
+struct ReplayResult {
+    uint64_t executed = 0;
+    double makespanMs = 0;
+    double throughput = 0;
+    double p50Us = 0, p99Us = 0, maxUs = 0;
+};
+
+// Each thread streams over the mapped trace and replays its own records.
+void replayWorker(LockEngine& engine, const locktrace::TraceFile& trace, int id,
+                  uint64_t origin, vector<uint64_t>& latencies, uint64_t& executed) {
+    for (const locktrace::TraceRecord* r = trace.begin(); r != trace.end(); ++r) {
+        if (r->thread != id) continue;
+        uint64_t due = origin + r->startNs;
+        for (uint64_t now = lockstats::nowNs(); now < due; now = lockstats::nowNs()) {
+            if (due - now > 200000) {
+                this_thread::sleep_for(nanoseconds(due - now - 100000));
+            } else {
+                this_thread::yield();
+            }
+        }
+        uint32_t length = r->durationNs;
+        engine.execute(id, [&executed, length] {
+            executed++;
+            spinFor(length);
+        });
+        // Latency counts from the recorded arrival, so falling behind shows up
+        latencies.push_back(lockstats::nowNs() - due);
+    }
+}
+
+ReplayResult replayTrace(const locktrace::TraceFile& trace, LockEngine& engine) {
+    int threadCount = trace.header()->threadCount;
+    vector<vector<uint64_t>> latencies(threadCount);
+    uint64_t executed = 0;
+
+    uint64_t origin = lockstats::nowNs() + 1000000; // Let every thread start first
+    vector<thread> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back(replayWorker, ref(engine), cref(trace), i, origin,
+                             ref(latencies[i]), ref(executed));
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    uint64_t end = lockstats::nowNs();
+
+    vector<uint64_t> all;
+    for (auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+    sort(all.begin(), all.end());
+
+    ReplayResult result;
+    result.executed = executed;
+    result.makespanMs = (end - origin) / 1e6;
+    result.throughput = executed * 1000.0 / result.makespanMs;
+    if (!all.empty()) {
+        result.p50Us = all[all.size() / 2] / 1000.0;
+        result.p99Us = all[all.size() * 99 / 100] / 1000.0;
+        result.maxUs = all.back() / 1000.0;
+    }
+    return result;
+}
+
+bool replayAll(const char* path, const vector<string>& engines) {
+    locktrace::TraceFile trace(path);
+    if (!trace.valid()) {
+        cerr << "Error: " << path << " is not a valid lock trace" << endl;
+        return false;
+    }
+    const locktrace::TraceHeader* h = trace.header();
+    uint64_t recordedSpan = h->recordCount ? (trace.end() - 1)->startNs : 0;
+    cout << "Trace " << path << ": " << h->recordCount << " records, "
+         << h->threadCount << " threads, arrivals over " << recordedSpan / 1e6 << " ms" << endl;
+
+    bool ok = true;
+    for (const string& name : engines) {
+        auto engine = makeEngine(name, h->threadCount);
+        if (!engine) {
+            cerr << "Error: unknown engine " << name << endl;
+            ok = false;
+            continue;
+        }
+        ReplayResult r = replayTrace(trace, *engine);
+        cout << "Engine: " << setw(10) << left << name << right << fixed << setprecision(1)
+             << " Time: " << r.makespanMs << " ms"
+             << ", Throughput: " << setprecision(0) << r.throughput << " ops/sec"
+             << ", Latency p50/p99/max: " << setprecision(1) << r.p50Us << "/" << r.p99Us
+             << "/" << r.maxUs << " us" << endl;
+        if (r.executed != h->recordCount) {
+            cout << "Error: Expected " << h->recordCount << " critical sections, got " << r.executed << endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    vector<string> allEngines(begin(ENGINE_NAMES), end(ENGINE_NAMES));
+
+    if (argc >= 3 && !strcmp(argv[1], "record")) {
+        string engine = argc > 3 ? argv[3] : "mutex";
+        int threads = argc > 4 ? atoi(argv[4]) : DEFAULT_THREADS;
+        int ops = argc > 5 ? atoi(argv[5]) : DEFAULT_OPERATIONS;
+        if (threads < 1 || (uint32_t)threads > locktrace::MAX_TRACE_THREADS) {
+            cerr << "Error: threads must be 1.." << locktrace::MAX_TRACE_THREADS << endl;
+            return 1;
+        }
+        return recordTrace(argv[2], engine, threads, ops) ? 0 : 1;
+    }
+    if (argc >= 3 && !strcmp(argv[1], "replay")) {
+        vector<string> engines(argv + 3, argv + argc);
+        return replayAll(argv[2], engines.empty() ? allEngines : engines) ? 0 : 1;
+    }
+    if (argc != 1) {
+        cerr << "Usage: " << argv[0] << " [record FILE [engine] [threads] [ops] | replay FILE [engine...]]" << endl;
+        return 1;
+    }
+
+    // Self-check: record a delegation run, then replay it on every engine
+    string path = "/tmp/lockreplay_" + to_string(getpid()) + ".trace";
+    bool ok = recordTrace(path.c_str(), "delegation", DEFAULT_THREADS, DEFAULT_OPERATIONS) &&
+              replayAll(path.c_str(), allEngines);
+    remove(path.c_str());
+
+    if (ok) {
+        cout << "Replay test passed" << endl;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,299 @@
+#pragma once
+
+// Live lock statistics published to a named POSIX shared-memory segment.
+//
+// Every engine owns one slot. Only one thread ever writes a slot at a time
+// (the lock holder for mutual-exclusion locks, the server thread for
+// delegation), so a seqlock is enough to give readers consistent snapshots.
+// The hot path only touches memory and the vDSO clock: the segment is mapped
+// once, when the first engine in the process registers.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lockstats {
+
+const int MAX_SLOTS = 32;
+const int KIND_LEN = 16;
+const int NAME_LEN = 48;
+const uint32_t SEGMENT_MAGIC = 0x4c4b5354; // "LKST"
+const char* const DEFAULT_SEGMENT = "/lockstats";
+const int READ_ATTEMPTS = 1000; // Seqlock retries before a reader gives up on a slot
+
+// Plain snapshot of one slot, as seen by readers.
+struct Counters {
+    uint64_t acquisitions = 0; // Critical sections entered / tasks executed
+    uint64_t contended = 0;    // Acquisitions that had to wait for someone else
+    uint64_t waitNs = 0;       // Sum of time spent waiting to enter
+    uint64_t queueDepth = 0;   // Delegation only: pending requests (gauge)
+    uint64_t busyNs = 0;       // Delegation only: time the server spent executing
+    uint64_t elapsedNs = 0;    // Delegation only: time since the server started
+};
+
+struct alignas(64) Slot {
+    std::atomic<uint32_t> inUse;
+    std::atomic<uint32_t> seq; // Odd while a write is in progress
+    std::atomic<int32_t> pid;
+    char kind[KIND_LEN];
+    char name[NAME_LEN];
+    std::atomic<uint64_t> acquisitions;
+    std::atomic<uint64_t> contended;
+    std::atomic<uint64_t> waitNs;
+    std::atomic<uint64_t> queueDepth;
+    std::atomic<uint64_t> busyNs;
+    std::atomic<uint64_t> elapsedNs;
+};
+
+struct Segment {
+    std::atomic<uint32_t> magic;
+    uint32_t slotCount;
+    Slot slots[MAX_SLOTS];
+};
+
+// steady_clock is served by the vDSO on Linux, so this does not enter the kernel.
+inline uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline const char* segmentName() {
+    const char* env = std::getenv("LOCKSTATS_SHM");
+    return (env && *env) ? env : DEFAULT_SEGMENT;
+}
+
+// Maps the segment for writing, creating it if needed. Falls back to private
+// memory when shared memory is unavailable so engines keep working.
+inline Segment* writableSegment() {
+    static Segment* segment = [] {
+        const char* name = segmentName();
+        void* mem = MAP_FAILED;
+        int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0666);
+        bool created = fd >= 0;
+        if (!created && errno == EEXIST) {
+            fd = shm_open(name, O_RDWR, 0666);
+        }
+        if (fd >= 0) {
+            struct stat st;
+            if (created) {
+                if (ftruncate(fd, sizeof(Segment)) != 0) {
+                    close(fd);
+                    fd = -1;
+                }
+            } else if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Segment)) {
+                // Creator has not finished (or the segment is from an older
+                // layout); do not risk mapping past its end.
+                close(fd);
+                fd = -1;
+            }
+        }
+        if (fd >= 0) {
+            mem = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+        }
+        if (mem == MAP_FAILED) {
+            mem = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            created = true;
+        }
+        Segment* seg = static_cast<Segment*>(mem);
+        if (created) {
+            seg->slotCount = MAX_SLOTS;
+            seg->magic.store(SEGMENT_MAGIC, std::memory_order_release);
+        }
+        return seg;
+    }();
+    return segment;
+}
+
+// Maps an existing segment read-only; returns nullptr if there is none.
+inline const Segment* attachSegment(const char* name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Segment)) {
+        close(fd);
+        return nullptr;
+    }
+    void* mem = mmap(nullptr, sizeof(Segment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) return nullptr;
+    const Segment* seg = static_cast<const Segment*>(mem);
+    if (seg->magic.load(std::memory_order_acquire) != SEGMENT_MAGIC) {
+        munmap(mem, sizeof(Segment));
+        return nullptr;
+    }
+    return seg;
+}
+
+enum class SlotRead {
+    Free,  // Not in use
+    Stale, // In use, but no consistent snapshot: its writer died mid-update
+           // or is updating faster than the reader can keep up
+    Ok,
+};
+
+// Seqlock read of one slot, giving up after READ_ATTEMPTS torn reads.
+inline SlotRead readSlot(const Slot& slot, Counters& out) {
+    for (int attempt = 0; attempt < READ_ATTEMPTS; ++attempt) {
+        if (!slot.inUse.load(std::memory_order_acquire)) return SlotRead::Free;
+        uint32_t before = slot.seq.load(std::memory_order_acquire);
+        if (before & 1) continue;
+        out.acquisitions = slot.acquisitions.load(std::memory_order_relaxed);
+        out.contended = slot.contended.load(std::memory_order_relaxed);
+        out.waitNs = slot.waitNs.load(std::memory_order_relaxed);
+        out.queueDepth = slot.queueDepth.load(std::memory_order_relaxed);
+        out.busyNs = slot.busyNs.load(std::memory_order_relaxed);
+        out.elapsedNs = slot.elapsedNs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) == before) return SlotRead::Ok;
+    }
+    return SlotRead::Stale;
+}
+
+// Per-engine publisher. Not thread-safe by design: callers guarantee a single
+// writer at a time (see the file comment).
+class StatsWriter {
+private:
+    Slot* slot = nullptr;
+    Counters local;
+
+    void publish() {
+        if (!slot) return;
+        uint32_t s = slot->seq.load(std::memory_order_relaxed);
+        slot->seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot->acquisitions.store(local.acquisitions, std::memory_order_relaxed);
+        slot->contended.store(local.contended, std::memory_order_relaxed);
+        slot->waitNs.store(local.waitNs, std::memory_order_relaxed);
+        slot->queueDepth.store(local.queueDepth, std::memory_order_relaxed);
+        slot->busyNs.store(local.busyNs, std::memory_order_relaxed);
+        slot->elapsedNs.store(local.elapsedNs, std::memory_order_relaxed);
+        slot->seq.store(s + 2, std::memory_order_release);
+    }
+
+    static bool isGone(int32_t pid) {
+        return pid > 0 && kill(pid, 0) != 0 && errno == ESRCH;
+    }
+
+public:
+    StatsWriter(const char* kind, const char* name) {
+        Segment* seg = writableSegment();
+        for (int i = 0; i < MAX_SLOTS && !slot; ++i) {
+            Slot& s = seg->slots[i];
+            uint32_t expected = 0;
+            if (s.inUse.compare_exchange_strong(expected, 1)) {
+                s.pid.store(getpid(), std::memory_order_relaxed);
+            } else {
+                // Reclaim a slot left behind by a process that died without
+                // cleanup: whoever swaps its pid for their own takes it
+                int32_t dead = s.pid.load(std::memory_order_relaxed);
+                if (!isGone(dead) || !s.pid.compare_exchange_strong(dead, getpid())) continue;
+            }
+            slot = &s;
+            // A writer that died mid-update leaves the sequence odd
+            uint32_t seq = slot->seq.load(std::memory_order_relaxed);
+            if (seq & 1) slot->seq.store(seq + 1, std::memory_order_relaxed);
+            std::strncpy(slot->kind, kind, KIND_LEN - 1);
+            slot->kind[KIND_LEN - 1] = '\0';
+            std::strncpy(slot->name, name, NAME_LEN - 1);
+            slot->name[NAME_LEN - 1] = '\0';
+            publish();
+        }
+        // All slots taken: the engine still works, it just is not visible.
+    }
+
+    ~StatsWriter() {
+        if (slot) {
+            slot->pid.store(0, std::memory_order_relaxed);
+            slot->inUse.store(0, std::memory_order_release);
+        }
+    }
+
+    StatsWriter(const StatsWriter&) = delete;
+    StatsWriter& operator=(const StatsWriter&) = delete;
+
+    void recordAcquire(bool contended, uint64_t waitNs) {
+        local.acquisitions++;
+        local.contended += contended ? 1 : 0;
+        local.waitNs += waitNs;
+        publish();
+    }
+
+    void recordTask(bool contended, uint64_t waitNs, uint64_t queueDepth,
+                    uint64_t busyNs, uint64_t elapsedNs) {
+        local.acquisitions++;
+        local.contended += contended ? 1 : 0;
+        local.waitNs += waitNs;
+        local.queueDepth = queueDepth;
+        local.busyNs += busyNs;
+        local.elapsedNs = elapsedNs;
+        publish();
+    }
+
+    // Replaces the counters with totals kept elsewhere.
+    void recordTotals(const Counters& totals) {
+        local = totals;
+        publish();
+    }
+};
+
+// Publisher for locks that let several threads in at once (group,
+// k-exclusion, multi-resource), where no single writer exists. Each thread
+// counts in its own cache line; a thread that finds the slot free sums them
+// and publishes, and one that finds it busy leaves its counts to the
+// publisher. Nobody waits on stats. Thread id is in 0..n-1.
+class SharedStatsWriter {
+private:
+    struct alignas(64) PerThread {
+        std::atomic<uint64_t> acquisitions{0};
+        std::atomic<uint64_t> contended{0};
+        std::atomic<uint64_t> waitNs{0};
+    };
+
+    std::vector<PerThread> threads;
+    std::atomic_flag publishing = ATOMIC_FLAG_INIT;
+    StatsWriter writer; // Written only by the holder of `publishing`
+
+    uint64_t totalAcquisitions() const {
+        uint64_t total = 0;
+        for (const PerThread& t : threads) total += t.acquisitions.load();
+        return total;
+    }
+
+public:
+    SharedStatsWriter(int n, const char* kind, const char* name) : threads(n), writer(kind, name) {}
+
+    void recordAcquire(int id, bool contended, uint64_t waitNs) {
+        // Only thread id writes its counters. Sequentially consistent, with
+        // the flag: a publisher that clears the flag after we failed to set
+        // it then sees our count, and publishes again.
+        PerThread& mine = threads[id];
+        mine.contended.store(mine.contended.load(std::memory_order_relaxed) + (contended ? 1 : 0));
+        mine.waitNs.store(mine.waitNs.load(std::memory_order_relaxed) + waitNs);
+        mine.acquisitions.store(mine.acquisitions.load(std::memory_order_relaxed) + 1);
+        for (;;) {
+            if (publishing.test_and_set()) return;
+            Counters totals;
+            for (const PerThread& t : threads) {
+                totals.acquisitions += t.acquisitions.load();
+                totals.contended += t.contended.load();
+                totals.waitNs += t.waitNs.load();
+            }
+            writer.recordTotals(totals);
+            publishing.clear();
+            if (totalAcquisitions() == totals.acquisitions) return;
+        }
+    }
+};
+
+} // namespace lockstats
@@ -0,0 +1,116 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include "LockStats.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Attaches to the live stats segment and prints a refreshing, top-like view
+// of every registered lock engine.
+//
+// Usage: LockTop [-s segment] [-i interval_ms] [-n iterations]
+
+struct SlotHistory {
+    int32_t pid = 0;
+    bool valid = false;
+    lockstats::Counters last;
+};
+
+void printHeader(const char* segment, int intervalMs) {
+    cout << "\033[H\033[2J";
+    cout << "lock top - segment " << segment << ", refresh " << intervalMs << " ms\n\n";
+    cout << left << setw(5) << "SLOT" << setw(8) << "PID" << setw(12) << "KIND"
+         << setw(24) << "NAME" << right << setw(12) << "ACQ/s" << setw(8) << "CONT%"
+         << setw(12) << "WAIT(us)" << setw(8) << "QDEPTH" << setw(8) << "UTIL%" << "\n";
+}
+
+int main(int argc, char** argv) {
+    const char* segment = lockstats::segmentName();
+    int intervalMs = 1000;
+    long iterations = -1; // Run until interrupted
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            segment = argv[++i];
+        } else if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+            intervalMs = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            iterations = atol(argv[++i]);
+        } else {
+            cerr << "Usage: " << argv[0] << " [-s segment] [-i interval_ms] [-n iterations]" << endl;
+            return 1;
+        }
+    }
+
+    const lockstats::Segment* seg = lockstats::attachSegment(segment);
+    if (!seg) {
+        cerr << "Error: no lock stats segment named " << segment
+             << " (start a program that uses a lock engine first)" << endl;
+        return 1;
+    }
+
+    SlotHistory history[lockstats::MAX_SLOTS];
+    double seconds = intervalMs / 1000.0;
+
+    for (long round = 0; iterations < 0 || round < iterations; ++round) {
+        printHeader(segment, intervalMs);
+
+        for (int i = 0; i < lockstats::MAX_SLOTS; ++i) {
+            const lockstats::Slot& slot = seg->slots[i];
+            lockstats::Counters now;
+            lockstats::SlotRead state = lockstats::readSlot(slot, now);
+            if (state == lockstats::SlotRead::Free) {
+                history[i].valid = false;
+                continue;
+            }
+            int32_t pid = slot.pid.load(memory_order_relaxed);
+            if (state == lockstats::SlotRead::Stale) {
+                cout << left << setw(5) << i << setw(8) << pid << setw(12) << slot.kind
+                     << setw(24) << string(slot.name).substr(0, 23) << right << setw(12) << "(stale)" << "\n";
+                continue;
+            }
+
+            // A new owner of the slot starts its counters from zero
+            SlotHistory& h = history[i];
+            if (!h.valid || h.pid != pid || now.acquisitions < h.last.acquisitions) {
+                h.last = lockstats::Counters();
+            }
+
+            uint64_t acq = now.acquisitions - h.last.acquisitions;
+            uint64_t cont = now.contended - h.last.contended;
+            uint64_t wait = now.waitNs - h.last.waitNs;
+            uint64_t busy = now.busyNs - h.last.busyNs;
+            uint64_t elapsed = now.elapsedNs - h.last.elapsedNs;
+
+            cout << left << setw(5) << i << setw(8) << pid << setw(12) << slot.kind
+                 << setw(24) << string(slot.name).substr(0, 23) << right << fixed
+                 << setw(12) << setprecision(0) << (acq / seconds)
+                 << setw(8) << setprecision(1) << (acq ? 100.0 * cont / acq : 0.0)
+                 << setw(12) << setprecision(2) << (acq ? wait / 1000.0 / acq : 0.0);
+            if (now.elapsedNs) {
+                cout << setw(8) << now.queueDepth
+                     << setw(8) << setprecision(1) << (elapsed ? 100.0 * busy / elapsed : 0.0);
+            } else {
+                cout << setw(8) << "-" << setw(8) << "-";
+            }
+            cout << "\n";
+
+            h.pid = pid;
+            h.valid = true;
+            h.last = now;
+        }
+        cout << flush;
+
+        if (iterations < 0 || round + 1 < iterations) {
+            this_thread::sleep_for(milliseconds(intervalMs));
+        }
+    }
+
+    return 0;
+}
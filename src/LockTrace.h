@@ -0,0 +1,160 @@
+#pragma once
+
+// Compact binary traces of critical sections, for recording a real run of an
+// engine and replaying it against the others.
+//
+// File layout: one TraceHeader followed by recordCount TraceRecords sorted by
+// start time. Start times are relative to the first arrival in the trace.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "LockEngines.h"
+#include "LockStats.h"
+
+namespace locktrace {
+
+const uint32_t TRACE_MAGIC = 0x4c4b5452; // "LKTR"
+const uint32_t TRACE_VERSION = 1;
+const uint32_t MAX_TRACE_THREADS = 1024; // Replay starts one thread each; ids fit in 16 bits
+
+struct TraceHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t threadCount;
+    uint32_t reserved;
+    uint64_t recordCount;
+};
+
+struct TraceRecord {
+    uint64_t startNs;    // When the thread asked for the critical section
+    uint32_t durationNs; // Time spent inside it
+    uint16_t thread;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(TraceRecord) == 16, "trace records must stay compact");
+
+// Collects records into per-thread buffers, so recording needs no
+// synchronisation and no I/O until write().
+class TraceRecorder {
+private:
+    std::vector<std::vector<TraceRecord>> perThread;
+
+public:
+    // Throws std::invalid_argument unless threads is in 1..MAX_TRACE_THREADS.
+    TraceRecorder(int threads, size_t reservePerThread = 0) {
+        if (threads < 1 || (uint32_t)threads > MAX_TRACE_THREADS) {
+            throw std::invalid_argument("TraceRecorder: thread count out of range");
+        }
+        perThread.resize(threads);
+        for (auto& buffer : perThread) buffer.reserve(reservePerThread);
+    }
+
+    // A tid outside 0..threads-1 is not recorded.
+    void record(int tid, uint64_t startNs, uint64_t durationNs) {
+        if (tid < 0 || (size_t)tid >= perThread.size()) return;
+        TraceRecord r;
+        r.startNs = startNs;
+        r.durationNs = (uint32_t)std::min<uint64_t>(durationNs, UINT32_MAX);
+        r.thread = (uint16_t)tid;
+        r.reserved = 0;
+        perThread[tid].push_back(r);
+    }
+
+    bool write(const char* path) const {
+        std::vector<TraceRecord> all;
+        for (const auto& buffer : perThread) {
+            all.insert(all.end(), buffer.begin(), buffer.end());
+        }
+        std::sort(all.begin(), all.end(), [](const TraceRecord& a, const TraceRecord& b) {
+            return a.startNs < b.startNs;
+        });
+        uint64_t origin = all.empty() ? 0 : all.front().startNs;
+        for (auto& r : all) r.startNs -= origin;
+
+        TraceHeader header = {TRACE_MAGIC, TRACE_VERSION, (uint32_t)perThread.size(), 0, all.size()};
+        FILE* f = std::fopen(path, "wb");
+        if (!f) return false;
+        bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1 &&
+                  (all.empty() || std::fwrite(all.data(), sizeof(TraceRecord), all.size(), f) == all.size());
+        return std::fclose(f) == 0 && ok;
+    }
+};
+
+// Read-only memory mapping of a trace file; records are used in place. A
+// record whose thread is not below the header's threadCount is never
+// replayed.
+class TraceFile {
+private:
+    void* mem = MAP_FAILED;
+    size_t length = 0;
+
+public:
+    TraceFile(const char* path) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(TraceHeader)) {
+            length = st.st_size;
+            mem = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (mem == MAP_FAILED) return;
+        madvise(mem, length, MADV_SEQUENTIAL);
+        // Divide rather than multiply: a corrupt recordCount must not wrap
+        // around and pass
+        const TraceHeader* h = header();
+        if (h->magic != TRACE_MAGIC || h->version != TRACE_VERSION ||
+            h->threadCount < 1 || h->threadCount > MAX_TRACE_THREADS ||
+            h->recordCount > (length - sizeof(TraceHeader)) / sizeof(TraceRecord)) {
+            munmap(mem, length);
+            mem = MAP_FAILED;
+        }
+    }
+
+    ~TraceFile() {
+        if (mem != MAP_FAILED) munmap(mem, length);
+    }
+
+    TraceFile(const TraceFile&) = delete;
+    TraceFile& operator=(const TraceFile&) = delete;
+
+    bool valid() const { return mem != MAP_FAILED; }
+    const TraceHeader* header() const { return static_cast<const TraceHeader*>(mem); }
+    const TraceRecord* begin() const { return reinterpret_cast<const TraceRecord*>(header() + 1); }
+    const TraceRecord* end() const { return begin() + header()->recordCount; }
+};
+
+// Wraps any engine and records every critical section that runs through it.
+class RecordingEngine : public LockEngine {
+private:
+    LockEngine& inner;
+    TraceRecorder& recorder;
+
+public:
+    RecordingEngine(LockEngine& engine, TraceRecorder& rec) : inner(engine), recorder(rec) {}
+
+    const char* name() const override { return inner.name(); }
+
+    void execute(int tid, const std::function<void()>& cs) override {
+        uint64_t arrival = lockstats::nowNs();
+        uint64_t duration = 0;
+        inner.execute(tid, [&] {
+            uint64_t begin = lockstats::nowNs();
+            cs();
+            duration = lockstats::nowNs() - begin;
+        });
+        recorder.record(tid, arrival, duration);
+    }
+};
+
+} // namespace locktrace
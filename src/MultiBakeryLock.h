@@ -0,0 +1,55 @@
+#pragma once
+
+// Acquiring a set of resources through one bakery doorway.
+//
+// A thread takes one ticket for the whole set, then waits only for threads
+// with an earlier ticket whose set overlaps its own. Threads with disjoint
+// sets never wait for each other. Since a thread waits only on earlier
+// tickets, no cycle of waiters can form: there is no deadlock whatever
+// sets are asked for, and no lock order for callers to follow. A thread
+// also cannot be overtaken by a later ticket whose set overlaps its own, so
+// a thread asking for many resources is not starved by streams of smaller
+// requests.
+//
+// The set shares a word with the ticket, which limits a lock to
+// MAX_RESOURCES resources.
+
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+
+#include "Calibration.h"
+#include "TicketWordBakery.h"
+
+class MultiBakeryLock {
+public:
+    using ResourceSet = uint32_t; // Bit r set: resource r
+    static const int MAX_RESOURCES = 32;
+
+    // Throws std::out_of_range unless every r is in 0..MAX_RESOURCES-1.
+    static ResourceSet resources(std::initializer_list<int> list) {
+        ResourceSet set = 0;
+        for (int r : list) {
+            if (r < 0 || r >= MAX_RESOURCES) throw std::out_of_range("MultiBakeryLock: resource out of range");
+            set |= ResourceSet(1) << r;
+        }
+        return set;
+    }
+
+private:
+    struct Overlap {
+        bool operator()(ResourceSet mine, ResourceSet theirs) const { return (mine & theirs) != 0; }
+    };
+
+    TicketWordBakery<Overlap> bakery;
+
+public:
+    MultiBakeryLock(int n, const Calibration& c = hostCalibration()) : bakery(n, "MultiBakeryLock", c) {}
+
+    void lock(int id, ResourceSet set) { bakery.lock(id, set); }
+
+    void unlock(int id) { bakery.unlock(id); }
+
+    // For tests: whether thread id is waiting or inside
+    bool hasTicket(int id) const { return bakery.hasTicket(id); }
+};
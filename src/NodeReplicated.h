@@ -0,0 +1,250 @@
+#pragma once
+
+// Node replication: one replica of the delegated state per NUMA node, kept
+// in step through a shared log of write operations.
+//
+// Threads attach to a node. A write is posted in the thread's slot on its
+// node; whichever thread of that node takes the node's combiner lock
+// collects every posted write, reserves that many log entries with a single
+// fetch_add, fills them, and then replays the log on the local replica up to
+// the end of its batch, which also applies other nodes' writes in log
+// order. A read runs on the local replica under a shared lock once the
+// replica has replayed everything logged when the read began, so reads
+// scale with nodes and never leave the node.
+//
+// The log is a ring. A combiner that would overwrite entries a replica has
+// not replayed yet waits, and meanwhile replays the lagging replicas itself
+// if their combiners are free.
+//
+// Nodes are whatever the caller says they are: pass the machine's NUMA node
+// count and attach threads by the node of their CPU, or fake a topology on
+// one socket.
+//
+// WriteOp is a struct with `long operator()(State&) const`; it is applied
+// once per replica, so it must be deterministic.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+#include "Calibration.h"
+
+template <typename State, typename WriteOp>
+class NodeReplicated {
+public:
+    static const int MAX_THREADS_PER_NODE = 64;
+
+    class Client;
+
+private:
+    enum SlotState { EMPTY, POSTED, DONE };
+
+    struct alignas(64) Slot {
+        std::atomic<int> state{EMPTY};
+        WriteOp op;
+        long result = 0;
+    };
+
+    struct LogEntry {
+        std::atomic<uint64_t> filled{0}; // Log index + 1 once op is written
+        WriteOp op;
+    };
+
+    struct alignas(64) Replica {
+        State state;
+        std::shared_mutex stateLock;       // Readers shared, replay exclusive
+        std::mutex combiner;
+        std::atomic<uint64_t> applied{0};  // Log entries replayed so far
+        Slot slots[MAX_THREADS_PER_NODE];
+        std::atomic<int> slotCount{0};
+        std::vector<std::unique_ptr<Client>> clients;
+        std::mutex attachMutex;
+
+        explicit Replica(const State& initial) : state(initial) {}
+    };
+
+    std::vector<std::unique_ptr<Replica>> replicas;
+    std::vector<LogEntry> log;
+    uint64_t mask;
+    alignas(64) std::atomic<uint64_t> logTail{0};
+    Calibration calib;
+
+    uint64_t minApplied() const {
+        uint64_t lowest = UINT64_MAX;
+        for (auto& r : replicas) {
+            lowest = std::min(lowest, r->applied.load(std::memory_order_acquire));
+        }
+        return lowest;
+    }
+
+    // Called with r.combiner held. Replays entries up to `to`; with
+    // wait=false stops at the first entry still being filled. Results of
+    // entries [first, first + batch.size()) go to those slots.
+    void replay(Replica& r, uint64_t to, bool wait, uint64_t first = 0,
+                const std::vector<Slot*>& batch = {}) {
+        uint64_t i = r.applied.load(std::memory_order_relaxed);
+        SpinWait filling(calib.spinBeforeYield, calib);
+        while (i < to) {
+            // Apply the run of entries that are ready, then publish it
+            std::unique_lock<std::shared_mutex> lock(r.stateLock);
+            uint64_t runStart = i;
+            while (i < to && log[i & mask].filled.load(std::memory_order_acquire) == i + 1) {
+                long result = log[i & mask].op(r.state);
+                if (i >= first && i - first < batch.size()) {
+                    batch[i - first]->result = result;
+                }
+                i++;
+            }
+            lock.unlock();
+            if (i > runStart) {
+                r.applied.store(i, std::memory_order_release);
+            } else if (!wait) {
+                return;
+            } else {
+                filling.once(); // Another combiner is filling entry i
+            }
+        }
+    }
+
+    // Called by a combiner about to write entries before `end`.
+    void waitForSpace(Replica& self, uint64_t end) {
+        SpinWait full(calib.spinBeforeYield, calib);
+        while (end - minApplied() > log.size()) {
+            replay(self, logTail.load(std::memory_order_acquire), false);
+            for (auto& r : replicas) {
+                if (r.get() != &self && r->applied.load(std::memory_order_acquire) + log.size() < end &&
+                    r->combiner.try_lock()) {
+                    replay(*r, logTail.load(std::memory_order_acquire), false);
+                    r->combiner.unlock();
+                }
+            }
+            full.once();
+        }
+    }
+
+    // Called with r.combiner held: logs and applies the node's posted
+    // writes, and brings the replica up to date.
+    void combine(Replica& r) {
+        std::vector<Slot*> batch;
+        int n = r.slotCount.load(std::memory_order_acquire);
+        for (int s = 0; s < n; ++s) {
+            if (r.slots[s].state.load(std::memory_order_acquire) == POSTED) {
+                batch.push_back(&r.slots[s]);
+            }
+        }
+
+        uint64_t first = logTail.fetch_add(batch.size(), std::memory_order_acq_rel);
+        uint64_t end = first + batch.size();
+        if (!batch.empty()) {
+            waitForSpace(r, end);
+            for (size_t k = 0; k < batch.size(); ++k) {
+                LogEntry& entry = log[(first + k) & mask];
+                entry.op = batch[k]->op;
+                entry.filled.store(first + k + 1, std::memory_order_release);
+            }
+        }
+        replay(r, end, true, first, batch);
+        for (Slot* slot : batch) {
+            slot->state.store(DONE, std::memory_order_release);
+        }
+    }
+
+public:
+    // A thread's handle on its node. Only that thread may use it.
+    class Client {
+    private:
+        friend class NodeReplicated;
+
+        NodeReplicated& nr;
+        Replica& replica;
+        Slot& slot;
+
+        Client(NodeReplicated& n, Replica& r, Slot& s) : nr(n), replica(r), slot(s) {}
+
+    public:
+        // Applies op on every replica, in one global order; returns its
+        // result on this node's replica.
+        long execute(const WriteOp& op) {
+            slot.op = op;
+            slot.state.store(POSTED, std::memory_order_release);
+            SpinWait wait(nr.calib.spinBeforeYield, nr.calib);
+            while (slot.state.load(std::memory_order_acquire) != DONE) {
+                if (replica.combiner.try_lock()) {
+                    nr.combine(replica);
+                    replica.combiner.unlock();
+                } else {
+                    wait.once();
+                }
+            }
+            slot.state.store(EMPTY, std::memory_order_relaxed);
+            return slot.result;
+        }
+
+        // Runs read(const State&) on this node's replica once it has every
+        // write logged before the call.
+        template <typename Read>
+        long read(Read read) {
+            uint64_t tail = nr.logTail.load(std::memory_order_acquire);
+            SpinWait wait(nr.calib.spinBeforeYield, nr.calib);
+            while (replica.applied.load(std::memory_order_acquire) < tail) {
+                if (replica.combiner.try_lock()) {
+                    nr.combine(replica);
+                    replica.combiner.unlock();
+                } else {
+                    wait.once();
+                }
+            }
+            std::shared_lock<std::shared_mutex> lock(replica.stateLock);
+            return read(static_cast<const State&>(replica.state));
+        }
+    };
+
+    // logCapacity is rounded up to a power of two, and to at least
+    // nodes * MAX_THREADS_PER_NODE.
+    NodeReplicated(int nodes, const State& initial = State(), size_t logCapacity = 4096,
+                   const Calibration& c = hostCalibration())
+        : calib(c) {
+        for (int n = 0; n < std::max(nodes, 1); ++n) {
+            replicas.emplace_back(new Replica(initial));
+        }
+        size_t size = 1;
+        // Room for every node's largest batch at once, so waiting combiners
+        // can always all fit once the replicas catch up
+        while (size < std::max<size_t>(logCapacity, replicas.size() * MAX_THREADS_PER_NODE)) size <<= 1;
+        log = std::vector<LogEntry>(size);
+        mask = size - 1;
+    }
+
+    NodeReplicated(const NodeReplicated&) = delete;
+    NodeReplicated& operator=(const NodeReplicated&) = delete;
+
+    // A handle for the calling thread on `node`; it lives as long as this
+    // object. Returns nullptr once the node has MAX_THREADS_PER_NODE threads.
+    Client* attach(int node) {
+        Replica& r = *replicas[node % replicas.size()];
+        std::lock_guard<std::mutex> lock(r.attachMutex);
+        int s = r.slotCount.load(std::memory_order_relaxed);
+        if (s == MAX_THREADS_PER_NODE) return nullptr;
+        r.clients.emplace_back(new Client(*this, r, r.slots[s]));
+        r.slotCount.store(s + 1, std::memory_order_release);
+        return r.clients.back().get();
+    }
+
+    int nodeCount() const { return (int)replicas.size(); }
+
+    // Only safe once no client is calling any more; replicas may lag until
+    // their node next reads or writes.
+    const State& unsafeReplica(int node) const { return replicas[node]->state; }
+
+    // Brings every replica up to date. Only safe once no client is calling.
+    void sync() {
+        for (auto& r : replicas) {
+            std::lock_guard<std::mutex> lock(r->combiner);
+            replay(*r, logTail.load(), true);
+        }
+    }
+};
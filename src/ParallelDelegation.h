@@ -0,0 +1,214 @@
+#pragma once
+
+// Delegation with conflict-aware parallel execution.
+//
+// Each request declares the keys it reads and writes. The server takes the
+// queued requests as one batch and builds a dependency graph in queue
+// order: a request depends on the last earlier writer of every key it
+// touches, and a writer also depends on every earlier reader since that
+// writer. Requests without pending dependencies run on the server and a
+// small worker group at once, and finishing one releases its dependents.
+// Two requests that conflict therefore run in queue order and the rest in
+// any order, which gives the same result as running the batch serially.
+//
+// Work must touch no shared data beyond its declared keys.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "LockStats.h"
+
+struct KeySet {
+    std::vector<uint64_t> reads;
+    std::vector<uint64_t> writes;
+};
+
+class ParallelDelegation {
+private:
+    struct Task {
+        KeySet keys;
+        std::function<void()> work;
+        std::promise<void> completion;
+        std::atomic<int> waitingOn{0};
+        std::vector<Task*> dependents;
+    };
+
+    struct KeyState {
+        Task* lastWriter = nullptr;
+        std::vector<Task*> readers; // Since lastWriter
+    };
+
+    std::mutex queueMutex;
+    std::condition_variable queueCV;
+    std::vector<std::unique_ptr<Task>> queue;
+
+    // Ready tasks of the current batch, shared with the workers
+    std::mutex readyMutex;
+    std::condition_variable readyCV;
+    std::deque<Task*> ready;
+    std::atomic<size_t> remaining{0};
+    bool workersRunning = true; // Guarded by readyMutex
+
+    std::atomic<bool> running{true};
+    std::vector<std::thread> workers;
+    std::thread serverThread;
+    lockstats::StatsWriter stats;
+
+    static void addEdge(Task* from, Task* to) {
+        if (from == nullptr || from == to) return;
+        // Skip the common repeat of one predecessor over several keys;
+        // other repeats only cost a redundant count
+        if (!from->dependents.empty() && from->dependents.back() == to) return;
+        from->dependents.push_back(to);
+        to->waitingOn.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void buildGraph(std::vector<std::unique_ptr<Task>>& batch) {
+        std::unordered_map<uint64_t, KeyState> keys;
+        for (auto& task : batch) {
+            Task* t = task.get();
+            for (uint64_t k : t->keys.reads) {
+                KeyState& key = keys[k];
+                addEdge(key.lastWriter, t);
+                key.readers.push_back(t);
+            }
+            for (uint64_t k : t->keys.writes) {
+                KeyState& key = keys[k];
+                addEdge(key.lastWriter, t);
+                for (Task* reader : key.readers) {
+                    addEdge(reader, t);
+                }
+                key.lastWriter = t;
+                key.readers.clear();
+            }
+        }
+    }
+
+    void run(Task* t) {
+        t->work();
+        t->completion.set_value();
+        int released = 0;
+        for (Task* next : t->dependents) {
+            if (next->waitingOn.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(readyMutex);
+                ready.push_back(next);
+                released++;
+            }
+        }
+        if (released > 1) {
+            readyCV.notify_all();
+        } else if (released == 1) {
+            readyCV.notify_one();
+        }
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(readyMutex);
+            readyCV.notify_all(); // Batch done: wake the server
+        }
+    }
+
+    // Runs ready tasks until the batch is done (server) or until stopped
+    // (workers).
+    void work(bool server) {
+        for (;;) {
+            Task* t;
+            {
+                std::unique_lock<std::mutex> lock(readyMutex);
+                readyCV.wait(lock, [&] {
+                    return !ready.empty() || (server ? remaining.load() == 0 : !workersRunning);
+                });
+                if (ready.empty()) return;
+                t = ready.front();
+                ready.pop_front();
+            }
+            run(t);
+        }
+    }
+
+    void serve() {
+        std::vector<std::unique_ptr<Task>> batch;
+        uint64_t startedNs = lockstats::nowNs();
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueCV.wait(lock, [this] { return !queue.empty() || !running; });
+                if (queue.empty()) return; // Stopped and drained
+                batch.swap(queue);
+            }
+
+            uint64_t begin = lockstats::nowNs();
+            buildGraph(batch);
+            remaining.store(batch.size(), std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(readyMutex);
+                for (auto& t : batch) {
+                    if (t->waitingOn.load(std::memory_order_relaxed) == 0) {
+                        ready.push_back(t.get());
+                    }
+                }
+            }
+            readyCV.notify_all();
+            work(true);
+            uint64_t end = lockstats::nowNs();
+            stats.recordTask(batch.size() > 1, 0, batch.size(), end - begin, end - startedNs);
+            batch.clear();
+        }
+    }
+
+    void stopWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(readyMutex);
+            workersRunning = false;
+        }
+        readyCV.notify_all();
+        for (auto& w : workers) {
+            w.join();
+        }
+    }
+
+public:
+    // workers: threads that run ready requests beside the server; 0 runs
+    // every request on the server, still in dependency order.
+    explicit ParallelDelegation(int workerCount = 3) : stats("delegation", "ParallelDelegation") {
+        for (int i = 0; i < workerCount; ++i) {
+            workers.emplace_back(&ParallelDelegation::work, this, false);
+        }
+        serverThread = std::thread(&ParallelDelegation::serve, this);
+    }
+
+    ~ParallelDelegation() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            running = false;
+        }
+        queueCV.notify_one();
+        serverThread.join();
+        stopWorkers();
+    }
+
+    ParallelDelegation(const ParallelDelegation&) = delete;
+    ParallelDelegation& operator=(const ParallelDelegation&) = delete;
+
+    std::future<void> async(KeySet keys, std::function<void()> work) {
+        std::unique_ptr<Task> task(new Task());
+        task->keys = std::move(keys);
+        task->work = std::move(work);
+        auto fut = task->completion.get_future();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queue.push_back(std::move(task));
+        }
+        queueCV.notify_one();
+        return fut;
+    }
+
+    int workerCount() const { return (int)workers.size(); }
+};
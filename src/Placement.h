@@ -0,0 +1,161 @@
+#pragma once
+
+// CPU pinning and placement planning from a measured core-to-core latency
+// matrix (written by the CoreLatency tool).
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+
+// Returns false if the CPU is not available to this process.
+inline bool pinCurrentThread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// CPUs this process may run on, in ascending order.
+inline std::vector<int> availableCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int i = 0; i < CPU_SETSIZE; ++i) {
+            if (CPU_ISSET(i, &set)) cpus.push_back(i);
+        }
+    }
+    if (cpus.empty()) cpus.push_back(0);
+    return cpus;
+}
+
+// cpus, ascending, in the kernel's cpulist format, e.g. "0-3,8"
+inline std::string cpuListString(const std::vector<int>& cpus) {
+    std::string out;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) ++j;
+        if (!out.empty()) out += ',';
+        out += std::to_string(cpus[i]);
+        if (j > i) out += '-' + std::to_string(cpus[j]);
+        i = j + 1;
+    }
+    return out;
+}
+
+// Round-trip latency between CPUs, in nanoseconds. Indexed by position in
+// `cpus`, not by CPU number.
+struct LatencyMatrix {
+    std::vector<int> cpus;
+    std::vector<double> ns;
+
+    int size() const { return (int)cpus.size(); }
+    double at(int i, int j) const { return ns[i * cpus.size() + j]; }
+    double& at(int i, int j) { return ns[i * cpus.size() + j]; }
+
+    void resize(const std::vector<int>& cpuList) {
+        cpus = cpuList;
+        ns.assign(cpus.size() * cpus.size(), 0.0);
+    }
+};
+
+// Reads one metric from the CSV the CoreLatency tool writes
+// ("metric,from_cpu,to_cpu,ns" rows; lines starting with '#' are comments).
+// Rows that do not parse are skipped.
+inline bool loadLatencyMatrix(const std::string& path, const std::string& metric, LatencyMatrix& out) {
+    std::ifstream in(path);
+    if (!in) return false;
+
+    struct Row { int from, to; double ns; };
+    // Whole field, no exceptions: a CPU number, and a finite latency
+    auto parseCpu = [](const std::string& field, int& cpu) {
+        char* end;
+        errno = 0;
+        long v = std::strtol(field.c_str(), &end, 10);
+        if (end == field.c_str() || *end != '\0' || errno != 0 || v < 0 || v >= CPU_SETSIZE) return false;
+        cpu = (int)v;
+        return true;
+    };
+    auto parseNs = [](const std::string& field, double& ns) {
+        char* end;
+        ns = std::strtod(field.c_str(), &end);
+        return end != field.c_str() && (*end == '\0' || *end == '\r') && std::isfinite(ns) && ns >= 0;
+    };
+    std::vector<Row> rows;
+    std::vector<int> cpus;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::stringstream ss(line);
+        std::string name, from, to, value;
+        if (!std::getline(ss, name, ',') || !std::getline(ss, from, ',') ||
+            !std::getline(ss, to, ',') || !std::getline(ss, value)) {
+            continue;
+        }
+        if (name != metric) continue;
+        Row r;
+        if (!parseCpu(from, r.from) || !parseCpu(to, r.to) || !parseNs(value, r.ns)) continue;
+        rows.push_back(r);
+        cpus.push_back(r.from);
+        cpus.push_back(r.to);
+    }
+    if (rows.empty()) return false;
+
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    out.resize(cpus);
+    auto index = [&cpus](int cpu) {
+        return (int)(std::lower_bound(cpus.begin(), cpus.end(), cpu) - cpus.begin());
+    };
+    for (const Row& r : rows) {
+        out.at(index(r.from), index(r.to)) = r.ns;
+    }
+    return true;
+}
+
+struct Placement {
+    int serverCpu = -1;          // Delegation server CPU, -1 when not used
+    std::vector<int> threadCpus; // One CPU per client/lock thread
+};
+
+// Picks a centre CPU and the threads closest to it. With a dedicated server,
+// the server sits on the centre and the clients go to the nearest other CPUs;
+// otherwise the centre itself takes the first thread. Threads wrap around when
+// there are more of them than CPUs.
+inline Placement planPlacement(const LatencyMatrix& m, int threads, bool dedicatedServer) {
+    Placement best;
+    double bestCost = std::numeric_limits<double>::max();
+    int n = m.size();
+    for (int centre = 0; centre < n; ++centre) {
+        std::vector<int> order;
+        for (int j = 0; j < n; ++j) {
+            if (!dedicatedServer || j != centre || n == 1) order.push_back(j);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return m.at(centre, a) < m.at(centre, b);
+        });
+
+        Placement p;
+        double cost = 0;
+        for (int t = 0; t < threads; ++t) {
+            int j = order[t % order.size()];
+            p.threadCpus.push_back(m.cpus[j]);
+            cost += m.at(centre, j);
+        }
+        if (dedicatedServer) p.serverCpu = m.cpus[centre];
+        if (cost < bestCost) {
+            bestCost = cost;
+            best = p;
+        }
+    }
+    return best;
+}
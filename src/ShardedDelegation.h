@@ -0,0 +1,112 @@
+#pragma once
+
+// Delegated state split across shards, one DelegationLock server per shard,
+// with atomic operations that span several shards.
+//
+// A single-shard operation is an ordinary request to that shard's server.
+// A multi-shard operation takes its shards in ascending order: a request on
+// the lowest shard holds that server and submits the next request, and so
+// on, until the request on the highest shard runs the operation on all the
+// states and releases the held servers. Each server runs one request at a
+// time, so while held it runs nothing else, and since every multi-shard
+// operation takes servers in the same order no two can wait on each other
+// in a cycle. Single-shard operations take the same path as before and pay
+// nothing for this; held servers are the cost of the multi-shard ones.
+
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "Calibration.h"
+#include "DelegationLock.h"
+
+template <typename State>
+class ShardedDelegation {
+public:
+    using MultiWork = std::function<void(std::vector<State*>&)>;
+
+private:
+    struct Shard {
+        State state;
+        DelegationLock server;
+
+        explicit Shard(const Calibration& c) : server(-1, c) {}
+    };
+
+    struct MultiOp {
+        std::vector<int> order;     // Positions in shards, by ascending shard
+        std::vector<int> shards;    // As the caller listed them
+        std::vector<State*> states; // Same order as shards
+        MultiWork work;
+        std::promise<void> release;
+        std::shared_future<void> released;
+        std::promise<void> done;
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    // Runs on the server of op->shards[op->order[step]], holding it
+    void hold(std::shared_ptr<MultiOp> op, size_t step) {
+        int position = op->order[step];
+        op->states[position] = &shards[op->shards[position]]->state;
+        if (step + 1 < op->order.size()) {
+            int next = op->shards[op->order[step + 1]];
+            shards[next]->server.async([this, op, step] { hold(op, step + 1); });
+            op->released.wait();
+        } else {
+            op->work(op->states);
+            op->release.set_value();
+            op->done.set_value();
+        }
+    }
+
+public:
+    explicit ShardedDelegation(int shardCount, const Calibration& c = hostCalibration()) {
+        for (int i = 0; i < std::max(shardCount, 1); ++i) {
+            shards.emplace_back(new Shard(c));
+        }
+    }
+
+    int shardCount() const { return (int)shards.size(); }
+
+    std::future<void> async(int shard, std::function<void(State&)> work) {
+        State* state = &shards[shard]->state;
+        return shards[shard]->server.async([state, work = std::move(work)] { work(*state); });
+    }
+
+    // Runs work atomically over the listed shards: at least one, all distinct;
+    // it receives their states in the order listed. Any other list fails the
+    // future with std::invalid_argument: a shard listed twice would be held
+    // by its own second step.
+    std::future<void> asyncMulti(std::vector<int> shardList, MultiWork work) {
+        auto op = std::make_shared<MultiOp>();
+        op->shards = std::move(shardList);
+        op->states.resize(op->shards.size());
+        op->order.resize(op->shards.size());
+        std::iota(op->order.begin(), op->order.end(), 0);
+        std::sort(op->order.begin(), op->order.end(),
+                  [&](int a, int b) { return op->shards[a] < op->shards[b]; });
+        auto sameShard = [&](int a, int b) { return op->shards[a] == op->shards[b]; };
+        if (op->shards.empty() || op->shards[op->order.front()] < 0 ||
+            op->shards[op->order.back()] >= shardCount() ||
+            std::adjacent_find(op->order.begin(), op->order.end(), sameShard) != op->order.end()) {
+            op->done.set_exception(std::make_exception_ptr(std::invalid_argument(
+                "ShardedDelegation: asyncMulti needs distinct shards, at least one")));
+            return op->done.get_future();
+        }
+        op->work = std::move(work);
+        op->released = op->release.get_future().share();
+        auto fut = op->done.get_future();
+
+        int first = op->shards[op->order[0]];
+        shards[first]->server.async([this, op] { hold(op, 0); });
+        return fut;
+    }
+
+    // Only safe once no operation is running.
+    State& unsafeState(int shard) { return shards[shard]->state; }
+};
@@ -0,0 +1,288 @@
+#pragma once
+
+// Point-in-time snapshots of state owned by a DelegationLock server.
+//
+// A snapshot is taken by a request on the server, so it falls between two
+// requests and sees no half-applied operation. The state is described as a
+// list of memory regions, and there are two ways to capture them:
+//
+//   Fork  the server forks; the child streams the regions to the file from
+//         its copy-on-write view of memory and exits. The server is paused
+//         only for the fork; afterwards the first write to each page pays a
+//         copy fault until the child is done.
+//   Copy  the server copies the regions into a buffer, and a writer thread
+//         streams the buffer out. The server is paused for the copy; nothing
+//         is slowed afterwards beyond the writer's I/O.
+//
+// Either way the file is written with large sequential writes to a
+// temporary file beside it, synced, and renamed over the last snapshot
+// before the snapshot's future completes. A snapshot that fails or is cut
+// short leaves the previous one in place.
+//
+// File layout: SnapshotHeader, then each region's bytes in order.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "DelegationLock.h"
+#include "LockStats.h"
+
+struct SnapshotRegion {
+    void* data;
+    size_t length;
+};
+
+enum class SnapshotMethod { Fork, Copy };
+
+struct SnapshotResult {
+    bool ok = false;
+    uint64_t bytes = 0;
+    uint64_t pauseNs = 0; // Time the server spent capturing
+    uint64_t totalNs = 0; // Request start to file synced
+};
+
+namespace snapshot {
+
+const uint32_t SNAPSHOT_MAGIC = 0x50414e53; // "SNAP"
+const uint32_t SNAPSHOT_VERSION = 1;
+const size_t WRITE_CHUNK = 1 << 20;
+
+struct SnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t regionCount;
+    uint32_t reserved;
+    uint64_t totalBytes;
+};
+
+// Only async-signal-safe calls, so a forked child of a threaded process
+// may use it.
+inline bool writeAll(int fd, const void* data, size_t length) {
+    const char* p = static_cast<const char*>(data);
+    while (length > 0) {
+        ssize_t n = write(fd, p, std::min(length, WRITE_CHUNK));
+        if (n <= 0) return false;
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+// Where a snapshot goes, worked out before any fork: writeFile() then
+// allocates nothing.
+struct SnapshotPaths {
+    std::string path;
+    std::string temp;      // Written first, then renamed over path
+    std::string directory; // Synced after the rename
+};
+
+inline SnapshotPaths pathsFor(const std::string& path) {
+    size_t slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    return {path, path + ".tmp", directory};
+}
+
+// Only async-signal-safe calls, like writeAll().
+inline bool writeFile(const SnapshotPaths& paths, const SnapshotRegion* regions, size_t count) {
+    int fd = open(paths.temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    SnapshotHeader h{SNAPSHOT_MAGIC, SNAPSHOT_VERSION, (uint32_t)count, 0, 0};
+    for (size_t i = 0; i < count; ++i) h.totalBytes += regions[i].length;
+    bool ok = writeAll(fd, &h, sizeof(h));
+    for (size_t i = 0; ok && i < count; ++i) {
+        ok = writeAll(fd, regions[i].data, regions[i].length);
+    }
+    ok = ok && fdatasync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    ok = ok && rename(paths.temp.c_str(), paths.path.c_str()) == 0;
+    if (!ok) {
+        unlink(paths.temp.c_str());
+        return false;
+    }
+    // Make the rename itself durable
+    int dir = open(paths.directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir < 0) return false;
+    ok = fsync(dir) == 0;
+    return close(dir) == 0 && ok;
+}
+
+// Reads a snapshot back into regions of the same sizes.
+inline bool load(const char* path, const std::vector<SnapshotRegion>& regions) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    SnapshotHeader h;
+    bool ok = read(fd, &h, sizeof(h)) == (ssize_t)sizeof(h) && h.magic == SNAPSHOT_MAGIC &&
+              h.version == SNAPSHOT_VERSION && h.regionCount == regions.size();
+    for (size_t i = 0; ok && i < regions.size(); ++i) {
+        char* p = static_cast<char*>(regions[i].data);
+        size_t left = regions[i].length;
+        while (ok && left > 0) {
+            ssize_t n = read(fd, p, std::min(left, WRITE_CHUNK));
+            ok = n > 0;
+            p += std::max<ssize_t>(n, 0);
+            left -= std::max<ssize_t>(n, 0);
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+} // namespace snapshot
+
+class Snapshotter {
+private:
+    DelegationLock& lock;
+    std::vector<SnapshotRegion> regions;
+
+    // Finishing a snapshot (reaping the fork child, or writing out the copy)
+    // runs on this object's own thread, one snapshot at a time.
+    std::mutex finishMutex;
+    std::condition_variable finishCV;
+    std::deque<std::function<void()>> finishing;
+    int inFlight = 0; // Requests from take() not yet run or discarded
+    bool stopping = false;
+    std::thread finisher;
+
+    // Held by a take() request; released when it has run, or when the lock
+    // drops it unrun
+    struct InFlight {
+        Snapshotter* owner;
+        explicit InFlight(Snapshotter* s) : owner(s) {}
+        ~InFlight() {
+            std::lock_guard<std::mutex> guard(owner->finishMutex);
+            owner->inFlight--;
+            owner->finishCV.notify_all();
+        }
+    };
+
+    void finishLoop() {
+        std::unique_lock<std::mutex> guard(finishMutex);
+        for (;;) {
+            finishCV.wait(guard, [this] { return !finishing.empty() || (stopping && inFlight == 0); });
+            if (finishing.empty()) return;
+            std::function<void()> job = std::move(finishing.front());
+            finishing.pop_front();
+            guard.unlock();
+            job();
+            guard.lock();
+        }
+    }
+
+    // On the server thread; false if the job could not be queued.
+    bool handOver(std::function<void()>&& job) {
+        try {
+            std::lock_guard<std::mutex> guard(finishMutex);
+            finishing.push_back(std::move(job));
+        } catch (const std::bad_alloc&) {
+            return false;
+        }
+        finishCV.notify_all();
+        return true;
+    }
+
+public:
+    // regions must only be changed by requests on lock.
+    Snapshotter(DelegationLock& l, std::vector<SnapshotRegion> r) : lock(l), regions(std::move(r)) {
+        finisher = std::thread(&Snapshotter::finishLoop, this);
+    }
+
+    // Waits for every snapshot taken to finish.
+    ~Snapshotter() {
+        {
+            std::lock_guard<std::mutex> guard(finishMutex);
+            stopping = true;
+        }
+        finishCV.notify_all();
+        finisher.join();
+    }
+
+    Snapshotter(const Snapshotter&) = delete;
+    Snapshotter& operator=(const Snapshotter&) = delete;
+
+    // Writes a snapshot to path; the future holds the result once the file
+    // is synced. The server is only held for the capture.
+    std::future<SnapshotResult> take(const std::string& path, SnapshotMethod method) {
+        auto done = std::make_shared<std::promise<SnapshotResult>>();
+        auto fut = done->get_future();
+        uint64_t startNs = lockstats::nowNs();
+        {
+            std::lock_guard<std::mutex> guard(finishMutex);
+            inFlight++;
+        }
+        auto held = std::make_shared<InFlight>(this);
+
+        lock.async([this, held, paths = snapshot::pathsFor(path), method, done, startNs] {
+            SnapshotResult result;
+            for (auto& r : regions) result.bytes += r.length;
+            uint64_t begin = lockstats::nowNs();
+
+            if (method == SnapshotMethod::Fork) {
+                pid_t pid = fork();
+                if (pid == 0) {
+                    _exit(snapshot::writeFile(paths, regions.data(), regions.size()) ? 0 : 1);
+                }
+                result.pauseNs = lockstats::nowNs() - begin;
+                if (pid < 0) {
+                    done->set_value(result);
+                    return;
+                }
+                auto finish = [pid, done, result, startNs]() mutable {
+                    int status = 0;
+                    result.ok = waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+                                WEXITSTATUS(status) == 0;
+                    result.totalNs = lockstats::nowNs() - startNs;
+                    done->set_value(result);
+                };
+                bool queued = false;
+                try {
+                    queued = handOver(finish);
+                } catch (const std::bad_alloc&) {
+                }
+                if (!queued) finish(); // Could not queue: reap the child here
+            } else {
+                // An exception must not escape onto the server thread, and
+                // the caller's future must still complete
+                try {
+                    // Uninitialised: the copy is the only pass over it
+                    std::shared_ptr<char> copy(new char[result.bytes], std::default_delete<char[]>());
+                    std::vector<SnapshotRegion> copied;
+                    size_t offset = 0;
+                    for (auto& r : regions) {
+                        std::memcpy(copy.get() + offset, r.data, r.length);
+                        copied.push_back({copy.get() + offset, r.length});
+                        offset += r.length;
+                    }
+                    result.pauseNs = lockstats::nowNs() - begin;
+                    if (handOver([paths, copy, copied, done, result, startNs]() mutable {
+                            result.ok = snapshot::writeFile(paths, copied.data(), copied.size());
+                            result.totalNs = lockstats::nowNs() - startNs;
+                            done->set_value(result);
+                        })) {
+                        return;
+                    }
+                } catch (const std::bad_alloc&) {
+                }
+                result.pauseNs = lockstats::nowNs() - begin;
+                result.totalNs = lockstats::nowNs() - startNs;
+                done->set_value(result);
+            }
+        });
+        return fut;
+    }
+};
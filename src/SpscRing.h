@@ -0,0 +1,76 @@
+#pragma once
+
+// Bounded single-producer single-consumer ring.
+//
+// The producer owns tail and the consumer owns head, each on its own cache
+// line next to a cached copy of the other side's index. Each side rereads
+// the other's index only when the cached copy says the ring is full (or
+// empty), so in steady state a push or pop touches no shared line but the
+// slot itself.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+template <typename T>
+class SpscRing {
+private:
+    std::vector<T> slots;
+    uint64_t mask;
+
+    alignas(64) std::atomic<uint64_t> head{0}; // Next slot to pop; written by the consumer
+    uint64_t cachedTail = 0;                    // Consumer's last look at tail
+
+    alignas(64) std::atomic<uint64_t> tail{0}; // Next slot to push; written by the producer
+    uint64_t cachedHead = 0;                    // Producer's last look at head
+
+public:
+    // capacity is rounded up to a power of two.
+    explicit SpscRing(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer only. Moves from item and returns true unless the ring is full.
+    bool tryPush(T& item) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead > mask) return false;
+        }
+        slots[t & mask] = std::move(item);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Returns false if the ring is empty.
+    bool tryPop(T& out) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail) return false;
+        }
+        out = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Either side; exact only when the other side is quiet.
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    size_t size() const {
+        uint64_t h = head.load(std::memory_order_acquire);
+        return tail.load(std::memory_order_acquire) - h;
+    }
+
+    size_t capacity() const { return mask + 1; }
+};
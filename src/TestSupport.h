@@ -0,0 +1,26 @@
+#pragma once
+
+// Helpers for the self-checking programs.
+
+#include <chrono>
+#include <thread>
+
+namespace testsupport {
+
+// Long enough that only a broken lock, not a loaded machine, runs out of it
+const std::chrono::seconds WAIT_LIMIT(10);
+
+// Waits, yielding, until pred() holds; false if it still does not after
+// limit. Tests use it to wait for a thread to reach a known point (say, to
+// publish its ticket) instead of sleeping and hoping it got there.
+template <typename Pred>
+bool waitUntil(Pred pred, std::chrono::steady_clock::duration limit = WAIT_LIMIT) {
+    auto deadline = std::chrono::steady_clock::now() + limit;
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+} // namespace testsupport
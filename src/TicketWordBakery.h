@@ -0,0 +1,91 @@
+#pragma once
+
+// A bakery whose entries carry a tag next to the ticket, for locks that let
+// some threads in together: a thread waits only for threads with an earlier
+// ticket whose tag conflicts with its own. GroupBakeryLock tags entries
+// with a session and MultiBakeryLock with a resource set.
+//
+// Conflict is `bool operator()(uint32_t mine, uint32_t theirs) const`, and
+// must be symmetric: two threads that enter together must each be free to
+// pass the other. Since a thread waits only on earlier tickets, no cycle of
+// waiters can form, and a thread is never overtaken by a later ticket that
+// conflicts with it.
+//
+// A thread's ticket and tag are one word, so a waiter never sees the ticket
+// of one entry with the tag of another.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "Calibration.h"
+#include "LockStats.h"
+
+template <typename Conflict>
+class TicketWordBakery {
+private:
+    std::vector<std::atomic<bool>> choosing;
+    std::vector<std::atomic<uint64_t>> entry; // Ticket << 32 | tag; 0 when outside
+    int threadCount;
+    Conflict conflict;
+    lockstats::SharedStatsWriter stats; // Threads that do not conflict are inside together
+    Calibration calib;
+
+    static uint32_t ticketOf(uint64_t e) { return (uint32_t)(e >> 32); }
+    static uint32_t tagOf(uint64_t e) { return (uint32_t)e; }
+
+public:
+    TicketWordBakery(int n, const char* name, const Calibration& c = hostCalibration())
+        : choosing(n), entry(n), threadCount(n), stats(n, "bakery", name), calib(c) {
+        for (int i = 0; i < n; ++i) {
+            choosing[i] = false;
+            entry[i] = 0;
+        }
+    }
+
+    void lock(int id, uint32_t tag) {
+        uint64_t start = lockstats::nowNs();
+        bool contended = false;
+        choosing[id] = true;
+
+        uint32_t maxTicket = 0;
+        for (int i = 0; i < threadCount; ++i) {
+            maxTicket = std::max(maxTicket, ticketOf(entry[i]));
+        }
+        uint32_t ticket = maxTicket + 1;
+        entry[id] = (uint64_t)ticket << 32 | tag;
+        choosing[id] = false;
+
+        // Wait for every earlier ticket whose tag conflicts with ours
+        for (int i = 0; i < threadCount; ++i) {
+            if (i == id) continue;
+
+            SpinWait choosingWait(calib.spinBeforeYield, calib);
+            while (choosing[i]) {
+                contended = true;
+                choosingWait.once();
+            }
+
+            SpinWait ticketWait(calib.spinBeforeYield, calib);
+            for (;;) {
+                uint64_t e = entry[i];
+                if (e == 0 || !conflict(tag, tagOf(e)) ||
+                    ticketOf(e) > ticket || (ticketOf(e) == ticket && i > id)) {
+                    break;
+                }
+                contended = true;
+                ticketWait.once();
+            }
+        }
+
+        stats.recordAcquire(id, contended, lockstats::nowNs() - start);
+    }
+
+    void unlock(int id) {
+        entry[id] = 0;
+    }
+
+    // For tests: whether thread id has taken a ticket, so is waiting or inside
+    bool hasTicket(int id) const { return entry[id] != 0; }
+};